@@ -0,0 +1,289 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_bench.cpp
+  * @author  LYH, CyberBeast
+  * @brief   Host-buildable micro-benchmarks for the CyberBeast motor control
+  *          protocol encoders and decoders, with stored regression baselines
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  * Usage:
+  *   make run                 build and run against baselines.txt
+  *   make baseline            rewrite baselines.txt with this machine's numbers
+  *
+  * A benchmark fails when it runs more than BENCH_TOLERANCE times slower than
+  * its stored baseline. Baselines are per-machine; regenerate them once on the
+  * box that runs the gate. The on-target equivalents of these numbers come
+  * from the MOTCTRL_PERF_ENABLE cycle instrumentation (see motctrl_perf.h),
+  * which wraps the same encode/decode/dispatch paths and the safety node's
+  * hall-to-CAN transmit path.
+  */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "motctrl_bulk.h"
+#include "motctrl_prot.h"
+
+#define BENCH_ITERATIONS 2000000
+#define BENCH_TOLERANCE 1.25  // fail when >25% slower than baseline
+#define BENCH_MAX_ENTRIES 32
+
+static double NowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Keep results observable so the optimizer cannot delete the loops
+static volatile uint32_t g_sink = 0;
+
+typedef double (*BenchFn)(void);
+
+static double BenchEncodeTorque(void)
+{
+  uint8_t buf[MOTCTRL_FRAME_SIZE];
+  double t0 = NowNs();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    MCReqTorqueControl(buf, 1.5 + (i & 7), 500);
+    g_sink += buf[1];
+  }
+  return (NowNs() - t0) / BENCH_ITERATIONS;
+}
+
+static double BenchEncodeSpeed(void)
+{
+  uint8_t buf[MOTCTRL_FRAME_SIZE];
+  double t0 = NowNs();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    MCReqSpeedControl(buf, 10.0 + (i & 7), 500);
+    g_sink += buf[1];
+  }
+  return (NowNs() - t0) / BENCH_ITERATIONS;
+}
+
+static double BenchEncodePosition(void)
+{
+  uint8_t buf[MOTCTRL_FRAME_SIZE];
+  double t0 = NowNs();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    MCReqPositionControl(buf, 3.14 + (i & 7), 500);
+    g_sink += buf[1];
+  }
+  return (NowNs() - t0) / BENCH_ITERATIONS;
+}
+
+static double BenchEncodePositionBatch(void)
+{
+  MCBatchEntry entries[12];
+  uint8_t block[12 * MOTCTRL_FRAME_SIZE] MOTCTRL_FRAME_BLOCK_ALIGNED;
+  for (int m = 0; m < 12; m++) {
+    entries[m].canID = 10 + m;
+    entries[m].setpoint = 0.5 * m;
+    entries[m].duration = 500;
+  }
+  int rounds = BENCH_ITERATIONS / 12;
+  double t0 = NowNs();
+  for (int i = 0; i < rounds; i++) {
+    entries[0].setpoint = 0.001 * (i & 1023);
+    MCReqPositionControlBatch(block, entries, 12);
+    g_sink += block[1];
+  }
+  return (NowNs() - t0) / ((double)rounds * 12);  // per frame, not per batch
+}
+
+static void MakeFeedbackFrame(uint8_t * buf, MOTCTRL_CMD cmd)
+{
+  memset(buf, 0, MOTCTRL_FRAME_SIZE);
+  buf[0] = (uint8_t)cmd;
+  buf[1] = 0;     // MOTCTRL_RES_SUCCESS
+  buf[2] = 42;    // temp
+  buf[3] = 0x34;  // position low
+  buf[4] = 0x82;  // position high
+  buf[5] = 0x7F;  // speed high 8 bits
+  buf[6] = 0xF8;  // speed low 4 | torque high 4
+  buf[7] = 0x21;  // torque low
+}
+
+static double BenchDecodeFeedbackDouble(void)
+{
+  uint8_t buf[MOTCTRL_FRAME_SIZE];
+  MakeFeedbackFrame(buf, MOTCTRL_CMD_TORQUE_CONTROL);
+  int8_t temp;
+  double position, speed, torque;
+  double t0 = NowNs();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    buf[3] = (uint8_t)i;
+    MCResTorqueControl(buf, temp, position, speed, torque);
+    g_sink += (uint32_t)temp;
+  }
+  return (NowNs() - t0) / BENCH_ITERATIONS;
+}
+
+static double BenchDecodeFeedbackQ15(void)
+{
+  uint8_t buf[MOTCTRL_FRAME_SIZE];
+  MakeFeedbackFrame(buf, MOTCTRL_CMD_TORQUE_CONTROL);
+  MCFeedbackQ15 feedback;
+  double t0 = NowNs();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    buf[3] = (uint8_t)i;
+    MCResTorqueControlQ15(buf, feedback);
+    g_sink += (uint32_t)feedback.position;
+  }
+  return (NowNs() - t0) / BENCH_ITERATIONS;
+}
+
+static double BenchDispatch(void)
+{
+  uint8_t buf[MOTCTRL_FRAME_SIZE];
+  MakeFeedbackFrame(buf, MOTCTRL_CMD_SPEED_CONTROL);
+  MCResAny result;
+  double t0 = NowNs();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    buf[3] = (uint8_t)i;
+    MCResDispatch(buf, result);
+    g_sink += (uint32_t)result.cmd;
+  }
+  return (NowNs() - t0) / BENCH_ITERATIONS;
+}
+
+static double BenchRoundtripTorque(void)
+{
+  uint8_t req[MOTCTRL_FRAME_SIZE];
+  uint8_t res[MOTCTRL_FRAME_SIZE];
+  MakeFeedbackFrame(res, MOTCTRL_CMD_TORQUE_CONTROL);
+  int8_t temp;
+  double position, speed, torque;
+  double t0 = NowNs();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    MCReqTorqueControl(req, 1.25 + (i & 3), 500);
+    res[3] = req[1];  // couple the two so neither loop can be hoisted
+    MCResTorqueControl(res, temp, position, speed, torque);
+    g_sink += (uint32_t)temp;
+  }
+  return (NowNs() - t0) / BENCH_ITERATIONS;
+}
+
+#define BENCH_BULK_FRAMES 65536
+
+static double BenchBulkDecode(void)
+{
+  static uint8_t frames[BENCH_BULK_FRAMES * MOTCTRL_FRAME_SIZE];
+  static uint8_t cmd[BENCH_BULK_FRAMES];
+  static int8_t temp[BENCH_BULK_FRAMES];
+  static float position[BENCH_BULK_FRAMES];
+  static float speed[BENCH_BULK_FRAMES];
+  static float torque[BENCH_BULK_FRAMES];
+  for (int i = 0; i < BENCH_BULK_FRAMES; i++) {
+    MakeFeedbackFrame(&frames[i * MOTCTRL_FRAME_SIZE], MOTCTRL_CMD_TORQUE_CONTROL);
+    frames[i * MOTCTRL_FRAME_SIZE + 3] = (uint8_t)i;
+    frames[i * MOTCTRL_FRAME_SIZE + 4] = (uint8_t)(i >> 8);
+  }
+  MCBulkColumns columns = { cmd, temp, position, speed, torque };
+  int rounds = BENCH_ITERATIONS / BENCH_BULK_FRAMES;
+  double t0 = NowNs();
+  for (int i = 0; i < rounds; i++) {
+    MCBulkDecodeFeedback(frames, BENCH_BULK_FRAMES, columns);
+    // through int32_t: float -> unsigned is undefined for negative values
+    g_sink += (uint32_t)(int32_t)position[i];
+  }
+  return (NowNs() - t0) / ((double)rounds * BENCH_BULK_FRAMES);
+}
+
+typedef struct {
+  const char * name;
+  BenchFn fn;
+} BenchCase;
+
+static const BenchCase s_cases[] = {
+  { "encode_torque", BenchEncodeTorque },
+  { "encode_speed", BenchEncodeSpeed },
+  { "encode_position", BenchEncodePosition },
+  { "encode_position_batch", BenchEncodePositionBatch },
+  { "decode_feedback_double", BenchDecodeFeedbackDouble },
+  { "decode_feedback_q15", BenchDecodeFeedbackQ15 },
+  { "dispatch", BenchDispatch },
+  { "bulk_decode", BenchBulkDecode },
+  { "roundtrip_torque", BenchRoundtripTorque },
+};
+#define BENCH_CASE_COUNT ((int)(sizeof(s_cases) / sizeof(s_cases[0])))
+
+typedef struct {
+  char name[48];
+  double ns;
+} Baseline;
+
+static int LoadBaselines(const char * path, Baseline * baselines)
+{
+  FILE * f = fopen(path, "r");
+  if (f == 0) {
+    return 0;
+  }
+  int count = 0;
+  while (count < BENCH_MAX_ENTRIES &&
+         fscanf(f, "%47s %lf", baselines[count].name, &baselines[count].ns) == 2) {
+    count++;
+  }
+  fclose(f);
+  return count;
+}
+
+static double FindBaseline(const Baseline * baselines, int count, const char * name)
+{
+  for (int i = 0; i < count; i++) {
+    if (strcmp(baselines[i].name, name) == 0) {
+      return baselines[i].ns;
+    }
+  }
+  return -1;
+}
+
+int main(int argc, char ** argv)
+{
+  bool update = argc > 1 && strcmp(argv[1], "--update-baselines") == 0;
+  const char * path = "baselines.txt";
+
+  Baseline baselines[BENCH_MAX_ENTRIES];
+  int baselineCount = update ? 0 : LoadBaselines(path, baselines);
+
+  FILE * out = update ? fopen(path, "w") : 0;
+  if (update && out == 0) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+
+  int failures = 0;
+  printf("%-24s %12s %14s %12s  %s\n", "benchmark", "ns/frame", "frames/s", "baseline", "result");
+  for (int i = 0; i < BENCH_CASE_COUNT; i++) {
+    double ns = s_cases[i].fn();
+    if (update) {
+      fprintf(out, "%s %.2f\n", s_cases[i].name, ns);
+      printf("%-24s %12.2f %14.0f %12s  %s\n", s_cases[i].name, ns, 1e9 / ns, "-", "SAVED");
+      continue;
+    }
+    double baseline = FindBaseline(baselines, baselineCount, s_cases[i].name);
+    const char * result;
+    if (baseline < 0) {
+      result = "NO BASELINE";
+    } else if (ns <= baseline * BENCH_TOLERANCE) {
+      result = "PASS";
+    } else {
+      result = "FAIL";
+      failures++;
+    }
+    printf("%-24s %12.2f %14.0f %12.2f  %s\n", s_cases[i].name, ns, 1e9 / ns,
+           baseline < 0 ? 0.0 : baseline, result);
+  }
+  if (update) {
+    fclose(out);
+  }
+  return failures == 0 ? 0 : 1;
+}
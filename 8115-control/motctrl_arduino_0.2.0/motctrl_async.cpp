@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_async.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides asynchronous request/response correlation for
+  *          the CyberBeast motor control protocol
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include "motctrl_async.h"
+
+void MCAsyncInit(MCAsyncEngine & engine)
+{
+  for (uint8_t i = 0; i < MOTCTRL_ASYNC_MAX_PENDING; i++) {
+    engine.pending[i].state = MOTCTRL_ASYNC_FREE;
+  }
+  engine.timeouts = 0;
+  engine.unmatched = 0;
+}
+
+int MCAsyncSubmit(MCAsyncEngine & engine, uint32_t canID, const uint8_t * reqBuf, uint32_t timeoutUs, uint32_t nowUs, MCAsyncCallback callback, void * userData)
+{
+  if (reqBuf == 0) {
+    return -1;
+  }
+  for (uint8_t i = 0; i < MOTCTRL_ASYNC_MAX_PENDING; i++) {
+    MCAsyncRequest & req = engine.pending[i];
+    if (req.state != MOTCTRL_ASYNC_FREE) {
+      continue;
+    }
+    req.state = MOTCTRL_ASYNC_PENDING;
+    req.cmd = reqBuf[0];
+    req.canID = canID;
+    req.issuedUs = nowUs;
+    req.timeoutUs = timeoutUs;
+    req.callback = callback;
+    req.userData = userData;
+    return i;
+  }
+  return -1;
+}
+
+bool MCAsyncOnResponse(MCAsyncEngine & engine, uint32_t canID, uint8_t * resBuf)
+{
+  if (resBuf == 0) {
+    return false;
+  }
+  for (uint8_t i = 0; i < MOTCTRL_ASYNC_MAX_PENDING; i++) {
+    MCAsyncRequest & req = engine.pending[i];
+    if (req.state != MOTCTRL_ASYNC_PENDING || req.canID != canID || req.cmd != resBuf[0]) {
+      continue;
+    }
+    MCResDispatch(resBuf, req.result);
+    req.state = MOTCTRL_ASYNC_DONE;
+    if (req.callback != 0) {
+      req.callback(req.canID, &req.result, req.userData);
+      req.state = MOTCTRL_ASYNC_FREE;  // callback consumed the slot
+    }
+    return true;
+  }
+  engine.unmatched++;
+  return false;
+}
+
+void MCAsyncPoll(MCAsyncEngine & engine, uint32_t nowUs)
+{
+  for (uint8_t i = 0; i < MOTCTRL_ASYNC_MAX_PENDING; i++) {
+    MCAsyncRequest & req = engine.pending[i];
+    if (req.state != MOTCTRL_ASYNC_PENDING) {
+      continue;
+    }
+    if (nowUs - req.issuedUs < req.timeoutUs) {
+      continue;
+    }
+    engine.timeouts++;
+    req.state = MOTCTRL_ASYNC_TIMEOUT;
+    if (req.callback != 0) {
+      req.callback(req.canID, 0, req.userData);
+      req.state = MOTCTRL_ASYNC_FREE;  // callback consumed the slot
+    }
+  }
+}
+
+MOTCTRL_ASYNC_STATE MCAsyncState(const MCAsyncEngine & engine, int handle)
+{
+  if (handle < 0 || handle >= MOTCTRL_ASYNC_MAX_PENDING) {
+    return MOTCTRL_ASYNC_FREE;
+  }
+  return (MOTCTRL_ASYNC_STATE)engine.pending[handle].state;
+}
+
+const MCResAny * MCAsyncResult(const MCAsyncEngine & engine, int handle)
+{
+  if (handle < 0 || handle >= MOTCTRL_ASYNC_MAX_PENDING) {
+    return 0;
+  }
+  if (engine.pending[handle].state != MOTCTRL_ASYNC_DONE) {
+    return 0;
+  }
+  return &engine.pending[handle].result;
+}
+
+void MCAsyncRelease(MCAsyncEngine & engine, int handle)
+{
+  if (handle < 0 || handle >= MOTCTRL_ASYNC_MAX_PENDING) {
+    return;
+  }
+  engine.pending[handle].state = MOTCTRL_ASYNC_FREE;
+}
@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_async.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides asynchronous request/response correlation for
+  *          the CyberBeast motor control protocol
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_ASYNC_H__
+#define _MOTCTRL_ASYNC_H__
+
+#include "motctrl_prot.h"
+
+#define MOTCTRL_ASYNC_MAX_PENDING 8
+
+/**
+ * lifecycle of a pending request slot
+*/
+typedef enum {
+  MOTCTRL_ASYNC_FREE = 0,
+  MOTCTRL_ASYNC_PENDING = 1,    // issued, response outstanding
+  MOTCTRL_ASYNC_DONE = 2,       // response decoded, result valid
+  MOTCTRL_ASYNC_TIMEOUT = 3,    // no response within the deadline
+} MOTCTRL_ASYNC_STATE;
+
+/**
+ * completion callback; result is 0 on timeout
+*/
+typedef void (*MCAsyncCallback)(uint32_t canID, const MCResAny * result, void * userData);
+
+/**
+ * one entry of the pending-request table
+*/
+typedef struct {
+  uint8_t state;             // @ref MOTCTRL_ASYNC_STATE
+  uint8_t cmd;               // command byte the response must carry
+  uint32_t canID;            // motor the request went to
+  uint32_t issuedUs;         // submit timestamp
+  uint32_t timeoutUs;        // straggler deadline relative to issuedUs
+  MCAsyncCallback callback;  // optional completion callback
+  void * userData;           // passed through to the callback
+  MCResAny result;           // decoded response, valid when state == DONE
+} MCAsyncRequest;
+
+/**
+ * correlation engine: several requests can be outstanding at once and
+ * responses are matched back by (motor CAN ID, command byte), so startup
+ * sweeps pipeline instead of serializing one bus round trip at a time
+*/
+typedef struct {
+  MCAsyncRequest pending[MOTCTRL_ASYNC_MAX_PENDING];
+  uint32_t timeouts;         // requests expired by MCAsyncPoll
+  uint32_t unmatched;        // responses that matched no pending request
+} MCAsyncEngine;
+
+/**
+ * @brief initialize the engine with an empty pending table
+ * @param engine the engine to initialize
+*/
+void MCAsyncInit(MCAsyncEngine & engine);
+/**
+ * @brief register an issued request for correlation
+ * @param engine the engine
+ * @param canID CAN ID the request frame was sent to
+ * @param reqBuf the encoded request frame (byte 0 carries the command)
+ * @param timeoutUs straggler deadline in us
+ * @param nowUs current monotonic time in us
+ * @param callback optional completion callback, 0 to poll instead
+ * @param userData opaque pointer handed to the callback
+ * @return handle for polling, -1 if the pending table is full
+*/
+int MCAsyncSubmit(MCAsyncEngine & engine, uint32_t canID, const uint8_t * reqBuf, uint32_t timeoutUs, uint32_t nowUs, MCAsyncCallback callback, void * userData);
+/**
+ * @brief correlate and decode a received response frame
+ * @param engine the engine
+ * @param canID CAN ID the frame came from
+ * @param resBuf response meesage buffer
+ * @return true if the frame matched a pending request
+*/
+bool MCAsyncOnResponse(MCAsyncEngine & engine, uint32_t canID, uint8_t * resBuf);
+/**
+ * @brief expire stragglers; fires callbacks with a 0 result
+ * @param engine the engine
+ * @param nowUs current monotonic time in us
+*/
+void MCAsyncPoll(MCAsyncEngine & engine, uint32_t nowUs);
+/**
+ * @brief query the state of a submitted request
+ * @param engine the engine
+ * @param handle handle returned by MCAsyncSubmit
+ * @return current slot state
+*/
+MOTCTRL_ASYNC_STATE MCAsyncState(const MCAsyncEngine & engine, int handle);
+/**
+ * @brief access the decoded result of a completed request
+ * @param engine the engine
+ * @param handle handle returned by MCAsyncSubmit
+ * @return decoded response, 0 unless the request is DONE
+*/
+const MCResAny * MCAsyncResult(const MCAsyncEngine & engine, int handle);
+/**
+ * @brief return a consumed slot to the free pool
+ * @param engine the engine
+ * @param handle handle returned by MCAsyncSubmit
+*/
+void MCAsyncRelease(MCAsyncEngine & engine, int handle);
+
+#endif
@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_bulk.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides bulk decoding of recorded CyberBeast feedback
+  *          frames into structure-of-arrays columns
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include "motctrl_bulk.h"
+
+uint32_t MCBulkDecodeFeedbackEx(const uint8_t * base, uint32_t strideBytes, uint32_t count, const MCBulkColumns & columns)
+{
+  if (base == 0 || strideBytes < MOTCTRL_FRAME_SIZE || columns.cmd == 0 || columns.temp == 0 ||
+      columns.position == 0 || columns.speed == 0 || columns.torque == 0) {
+    return 0;
+  }
+
+  // One strided pass per column keeps every store unit-stride and the loop
+  // bodies free of branches and cross-iteration dependencies, which is what
+  // the auto-vectorizer needs; the source block stays in cache across passes
+  // for the chunk sizes a log reader hands in.
+  const uint8_t * f = base;
+  uint8_t * cmd = columns.cmd;
+  int8_t * temp = columns.temp;
+  float * position = columns.position;
+  float * speed = columns.speed;
+  float * torque = columns.torque;
+
+  for (uint32_t i = 0; i < count; i++) {
+    cmd[i] = f[i * strideBytes];
+    temp[i] = (int8_t)f[i * strideBytes + 2];
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    const uint8_t * p = &f[i * strideBytes];
+    // unsigned offset-binary on the wire: 0x0000 = -12.5 RAD, 0xFFFF = +12.5
+    uint16_t pos_raw = (uint16_t)((uint16_t)p[3] | ((uint16_t)p[4] << 8));
+    position[i] = (float)pos_raw * (float)MOTCTRL_POS_SCALE - 12.5f;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    const uint8_t * p = &f[i * strideBytes];
+    uint16_t speed_raw = (uint16_t)(((uint16_t)p[5] << 4) | (p[6] >> 4));
+    speed[i] = (float)speed_raw * (float)MOTCTRL_SPEED_SCALE - 65.0f;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    const uint8_t * p = &f[i * strideBytes];
+    uint16_t torque_raw = (uint16_t)(((uint16_t)(p[6] & 0x0F) << 8) | p[7]);
+    torque[i] = (float)torque_raw * (float)MOTCTRL_TORQUE_SCALE - 225.0f;
+  }
+  return count;
+}
+
+uint32_t MCBulkDecodeFeedback(const uint8_t * frames, uint32_t count, const MCBulkColumns & columns)
+{
+  return MCBulkDecodeFeedbackEx(frames, MOTCTRL_FRAME_SIZE, count, columns);
+}
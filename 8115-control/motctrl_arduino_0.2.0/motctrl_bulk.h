@@ -0,0 +1,57 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_bulk.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides bulk decoding of recorded CyberBeast feedback
+  *          frames into structure-of-arrays columns
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_BULK_H__
+#define _MOTCTRL_BULK_H__
+
+#include "motctrl_prot.h"
+
+/**
+ * column output of the bulk decoder; every pointer must address at least
+ * count elements. Separate columns keep each field contiguous for the
+ * analysis passes that follow and let the decode loop auto-vectorize.
+*/
+typedef struct {
+  uint8_t * cmd;     // command byte of each frame, for filtering afterwards
+  int8_t * temp;     // temperature in Centigrade
+  float * position;  // in RAD
+  float * speed;     // in RAD/s
+  float * torque;    // in Amper
+} MCBulkColumns;
+
+/**
+ * @brief decode a contiguous array of recorded feedback frames into columns;
+ *        every frame is unpacked branch-free, filter on the cmd column to
+ *        keep only MOTCTRL_CMD_TORQUE/SPEED/POSITION_CONTROL responses
+ * @param frames source block of count * MOTCTRL_FRAME_SIZE bytes
+ * @param count number of frames in the block
+ * @param columns destination columns, all pointers non-null
+ * @return number of frames decoded
+*/
+uint32_t MCBulkDecodeFeedback(const uint8_t * frames, uint32_t count, const MCBulkColumns & columns);
+/**
+ * @brief strided variant for frames embedded in larger records, e.g. a
+ *        memory-mapped MCLogRecord array (stride MOTCTRL_LOG_RECORD_SIZE,
+ *        base pointing at the first record's frame field)
+ * @param base address of the first frame
+ * @param strideBytes distance between consecutive frames, in bytes
+ * @param count number of frames
+ * @param columns destination columns, all pointers non-null
+ * @return number of frames decoded
+*/
+uint32_t MCBulkDecodeFeedbackEx(const uint8_t * base, uint32_t strideBytes, uint32_t count, const MCBulkColumns & columns);
+
+#endif
@@ -0,0 +1,138 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_bus.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides a multi-bus fan-out layer partitioning motors
+  *          across several CAN interfaces
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include "motctrl_bus.h"
+
+#define MOTCTRL_BUS_RING_MASK (MOTCTRL_BUS_FEEDBACK_RING - 1)
+
+void MCBusSetInit(MCBusSet & set)
+{
+  set.busCount = 0;
+  set.motorCount = 0;
+}
+
+int MCBusAdd(MCBusSet & set, MCBusSendFn send, void * ctx)
+{
+  if (set.busCount >= MOTCTRL_BUS_MAX_BUSES || send == 0) {
+    return -1;
+  }
+  MCBusIf * bus = &set.buses[set.busCount];
+  bus->send = send;
+  bus->ctx = ctx;
+  bus->motorCount = 0;
+  bus->head = 0;
+  bus->tail = 0;
+  bus->sent = 0;
+  bus->sendFailures = 0;
+  bus->overruns = 0;
+  return set.busCount++;
+}
+
+int MCBusAddMotor(MCBusSet & set, uint32_t canID)
+{
+  if (set.busCount == 0 || set.motorCount >= MOTCTRL_BUS_MAX_MOTORS) {
+    return -1;
+  }
+  // Least-loaded partitioning keeps motors-per-bus balanced, which is what
+  // bounds per-bus latency independently of fleet size
+  int target = 0;
+  for (uint8_t b = 1; b < set.busCount; b++) {
+    if (set.buses[b].motorCount < set.buses[target].motorCount) {
+      target = b;
+    }
+  }
+  set.motorIDs[set.motorCount] = canID;
+  set.motorBus[set.motorCount] = (uint8_t)target;
+  set.motorCount++;
+  set.buses[target].motorCount++;
+  return target;
+}
+
+int MCBusOf(const MCBusSet & set, uint32_t canID)
+{
+  for (uint8_t i = 0; i < set.motorCount; i++) {
+    if (set.motorIDs[i] == canID) {
+      return set.motorBus[i];
+    }
+  }
+  return -1;
+}
+
+uint32_t MCBusFanOut(MCBusSet & set, const MCBatchEntry * entries, const uint8_t * frameBlock, uint32_t count)
+{
+  uint32_t accepted = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    int b = MCBusOf(set, entries[i].canID);
+    if (b < 0) {
+      continue;
+    }
+    MCBusIf * bus = &set.buses[b];
+    if (bus->send(bus->ctx, entries[i].canID, &frameBlock[i * MOTCTRL_FRAME_SIZE])) {
+      bus->sent++;
+      accepted++;
+    } else {
+      bus->sendFailures++;
+    }
+  }
+  return accepted;
+}
+
+bool MCBusOnFeedback(MCBusSet & set, int bus, uint32_t timestampUs, uint32_t canID, const uint8_t * frame)
+{
+  if (bus < 0 || bus >= set.busCount) {
+    return false;
+  }
+  MCBusIf * b = &set.buses[bus];
+  uint8_t head = b->head;
+  uint8_t next = (uint8_t)((head + 1) & MOTCTRL_BUS_RING_MASK);
+  if (next == b->tail) {
+    b->overruns++;
+    return false;
+  }
+  MCBusFeedback * slot = &b->ring[head];
+  slot->timestampUs = timestampUs;
+  slot->canID = canID;
+  for (uint8_t i = 0; i < MOTCTRL_FRAME_SIZE; i++) {
+    slot->frame[i] = frame[i];
+  }
+  b->head = next;  // publish after the slot is fully written
+  return true;
+}
+
+bool MCBusNextFeedback(MCBusSet & set, MCBusFeedback & out)
+{
+  // Pick the oldest head across all rings; wrap-safe signed comparison so
+  // a us-counter rollover does not reorder the merged stream
+  int oldest = -1;
+  for (uint8_t b = 0; b < set.busCount; b++) {
+    MCBusIf * bus = &set.buses[b];
+    if (bus->tail == bus->head) {
+      continue;
+    }
+    if (oldest < 0 ||
+        (int32_t)(bus->ring[bus->tail].timestampUs -
+                  set.buses[oldest].ring[set.buses[oldest].tail].timestampUs) < 0) {
+      oldest = b;
+    }
+  }
+  if (oldest < 0) {
+    return false;
+  }
+  MCBusIf * bus = &set.buses[oldest];
+  out = bus->ring[bus->tail];
+  bus->tail = (uint8_t)((bus->tail + 1) & MOTCTRL_BUS_RING_MASK);
+  return true;
+}
@@ -0,0 +1,132 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_bus.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides a multi-bus fan-out layer partitioning motors
+  *          across several CAN interfaces
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_BUS_H__
+#define _MOTCTRL_BUS_H__
+
+#include "motctrl_prot.h"
+
+#define MOTCTRL_BUS_MAX_BUSES 4
+#define MOTCTRL_BUS_MAX_MOTORS 32
+#define MOTCTRL_BUS_FEEDBACK_RING 32  // per-bus feedback slots, power of two
+
+/**
+ * transport operation: queue one frame on a physical interface. Must not
+ * block; the library stays transport-agnostic, so the host supplies one of
+ * these per interface (TWAI, SocketCAN, USB adapter, ...)
+*/
+typedef bool (*MCBusSendFn)(void * ctx, uint32_t canID, const uint8_t * frame);
+
+/**
+ * one received feedback frame with its capture time
+*/
+typedef struct {
+  uint32_t timestampUs;               // monotonic us at reception
+  uint32_t canID;                     // CAN ID the frame came from
+  uint8_t frame[MOTCTRL_FRAME_SIZE];  // raw frame payload
+} MCBusFeedback;
+
+/**
+ * one physical interface: a send op plus a single-producer single-consumer
+ * feedback ring. The producer is that bus's RX context (worker thread or
+ * ISR), the consumer is the merge side, so no lock is needed.
+*/
+typedef struct {
+  MCBusSendFn send;           // transport op
+  void * ctx;                 // handed to the transport op
+  uint8_t motorCount;         // motors partitioned onto this bus
+  MCBusFeedback ring[MOTCTRL_BUS_FEEDBACK_RING];
+  volatile uint8_t head;      // producer index
+  volatile uint8_t tail;      // consumer index
+  uint32_t sent;              // frames handed to the transport op
+  uint32_t sendFailures;      // transport op returned false
+  uint32_t overruns;          // feedback frames dropped, ring full
+} MCBusIf;
+
+/**
+ * bus set: owns N interfaces, partitions motors across them so each bus
+ * carries an equal share, fans batched command blocks out to the owning
+ * buses and merges the per-bus feedback rings into one time-ordered stream
+ * for the correlation engine. Per-bus load -- and with it worst-case bus
+ * latency -- depends only on motors-per-bus, not on fleet size.
+*/
+typedef struct {
+  MCBusIf buses[MOTCTRL_BUS_MAX_BUSES];
+  uint8_t busCount;           // number of interfaces in the set
+  uint32_t motorIDs[MOTCTRL_BUS_MAX_MOTORS];
+  uint8_t motorBus[MOTCTRL_BUS_MAX_MOTORS];  // owning bus of each motor
+  uint8_t motorCount;         // number of motors partitioned
+} MCBusSet;
+
+/**
+ * @brief initialize an empty bus set
+ * @param set the set to initialize
+*/
+void MCBusSetInit(MCBusSet & set);
+/**
+ * @brief add a physical interface
+ * @param set the set
+ * @param send transport op queueing one frame on the interface
+ * @param ctx opaque pointer handed to the transport op
+ * @return bus index, -1 when the set is full
+*/
+int MCBusAdd(MCBusSet & set, MCBusSendFn send, void * ctx);
+/**
+ * @brief register a motor; partitioned onto the least-loaded bus
+ * @param set the set
+ * @param canID CAN ID of the motor
+ * @return owning bus index, -1 when no bus exists or the table is full
+*/
+int MCBusAddMotor(MCBusSet & set, uint32_t canID);
+/**
+ * @brief owning bus of a motor
+ * @param set the set
+ * @param canID CAN ID of the motor
+ * @return bus index, -1 for unknown motors
+*/
+int MCBusOf(const MCBusSet & set, uint32_t canID);
+/**
+ * @brief fan a batch-encoded command block out to the owning buses; frame i
+ *        of frameBlock belongs to entries[i] (the layout produced by
+ *        MCReq*ControlBatch)
+ * @param set the set
+ * @param entries batch entries carrying the target CAN IDs
+ * @param frameBlock encoded frames, count * MOTCTRL_FRAME_SIZE bytes
+ * @param count number of entries
+ * @return number of frames accepted by the transport ops
+*/
+uint32_t MCBusFanOut(MCBusSet & set, const MCBatchEntry * entries, const uint8_t * frameBlock, uint32_t count);
+/**
+ * @brief push a received frame into a bus's feedback ring (that bus's RX
+ *        context only -- one producer per ring)
+ * @param set the set
+ * @param bus index of the bus the frame arrived on
+ * @param timestampUs monotonic capture time in us
+ * @param canID CAN ID the frame came from
+ * @param frame raw frame payload
+ * @return true if the frame was queued, false on overrun
+*/
+bool MCBusOnFeedback(MCBusSet & set, int bus, uint32_t timestampUs, uint32_t canID, const uint8_t * frame);
+/**
+ * @brief pop the oldest queued feedback frame across all buses, giving the
+ *        correlation engine one time-ordered view of the whole fleet
+ * @param set the set
+ * @param out receives the frame
+ * @return true if a frame was popped
+*/
+bool MCBusNextFeedback(MCBusSet & set, MCBusFeedback & out);
+
+#endif
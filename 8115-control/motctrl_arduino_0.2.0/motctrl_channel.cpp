@@ -0,0 +1,143 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_channel.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides a preallocated frame pool and a per-motor
+  *          channel object over the CyberBeast motor control protocol
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include "motctrl_channel.h"
+
+MCFrameHandle::MCFrameHandle(MCFrameHandle && other)
+  : pool(other.pool), index(other.index)
+{
+  other.pool = 0;
+  other.index = -1;
+}
+
+MCFrameHandle & MCFrameHandle::operator=(MCFrameHandle && other)
+{
+  if (this != &other) {
+    Release();
+    pool = other.pool;
+    index = other.index;
+    other.pool = 0;
+    other.index = -1;
+  }
+  return *this;
+}
+
+MCFrameHandle::~MCFrameHandle()
+{
+  Release();
+}
+
+uint8_t * MCFrameHandle::Data()
+{
+  if (!Valid()) {
+    return 0;
+  }
+  return pool->slots[index];
+}
+
+void MCFrameHandle::Release()
+{
+  if (Valid()) {
+    pool->Release(index);
+    pool = 0;
+    index = -1;
+  }
+}
+
+MCFramePool::MCFramePool()
+{
+  freeMask = (uint16_t)((1UL << MOTCTRL_POOL_SLOTS) - 1);
+  exhausted = 0;
+}
+
+MCFrameHandle MCFramePool::Acquire()
+{
+  for (int i = 0; i < MOTCTRL_POOL_SLOTS; i++) {
+    uint16_t bit = (uint16_t)(1 << i);
+    if (freeMask & bit) {
+      freeMask &= (uint16_t)~bit;
+      return MCFrameHandle(this, i);
+    }
+  }
+  exhausted++;
+  return MCFrameHandle();
+}
+
+uint8_t MCFramePool::FreeSlots() const
+{
+  uint8_t free = 0;
+  for (int i = 0; i < MOTCTRL_POOL_SLOTS; i++) {
+    if (freeMask & (uint16_t)(1 << i)) {
+      free++;
+    }
+  }
+  return free;
+}
+
+void MCFramePool::Release(int slot)
+{
+  freeMask |= (uint16_t)(1 << slot);
+}
+
+MCFrameHandle MotorChannel::StartMotor()
+{
+  MCFrameHandle frame = pool.Acquire();
+  if (frame.Valid()) {
+    MCReqStartMotor(frame.Data());
+  }
+  return frame;
+}
+
+MCFrameHandle MotorChannel::StopMotor()
+{
+  MCFrameHandle frame = pool.Acquire();
+  if (frame.Valid()) {
+    MCReqStopMotor(frame.Data());
+  }
+  return frame;
+}
+
+MCFrameHandle MotorChannel::TorqueControl(double torque, uint32_t duration)
+{
+  MCFrameHandle frame = pool.Acquire();
+  if (frame.Valid()) {
+    MCReqTorqueControl(frame.Data(), torque, duration);
+  }
+  return frame;
+}
+
+MCFrameHandle MotorChannel::SpeedControl(double speed, uint32_t duration)
+{
+  MCFrameHandle frame = pool.Acquire();
+  if (frame.Valid()) {
+    MCReqSpeedControl(frame.Data(), speed, duration);
+  }
+  return frame;
+}
+
+MCFrameHandle MotorChannel::PositionControl(double position, uint32_t duration)
+{
+  MCFrameHandle frame = pool.Acquire();
+  if (frame.Valid()) {
+    MCReqPositionControl(frame.Data(), position, duration);
+  }
+  return frame;
+}
+
+MOTCTRL_RES MotorChannel::Decode(uint8_t * resBuf, MCResAny & result)
+{
+  return MCResDispatch(resBuf, result);
+}
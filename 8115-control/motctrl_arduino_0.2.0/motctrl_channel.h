@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_channel.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides a preallocated frame pool and a per-motor
+  *          channel object over the CyberBeast motor control protocol
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_CHANNEL_H__
+#define _MOTCTRL_CHANNEL_H__
+
+#include "motctrl_prot.h"
+
+#define MOTCTRL_POOL_SLOTS 16
+
+class MCFramePool;
+
+/**
+ * move-only handle to one pooled frame slot; the slot is recycled when the
+ * handle goes out of scope, so frames cannot leak and the pool never touches
+ * the heap
+*/
+class MCFrameHandle {
+public:
+  MCFrameHandle() : pool(0), index(-1) {}
+  MCFrameHandle(MCFrameHandle && other);
+  MCFrameHandle & operator=(MCFrameHandle && other);
+  ~MCFrameHandle();
+
+  MCFrameHandle(const MCFrameHandle &) = delete;
+  MCFrameHandle & operator=(const MCFrameHandle &) = delete;
+
+  /**
+   * @brief whether the handle owns a slot
+  */
+  bool Valid() const { return index >= 0; }
+  /**
+   * @brief the MOTCTRL_FRAME_SIZE byte frame buffer, 0 when not Valid()
+  */
+  uint8_t * Data();
+  /**
+   * @brief return the slot to the pool early, before destruction
+  */
+  void Release();
+
+private:
+  friend class MCFramePool;
+  MCFrameHandle(MCFramePool * owner, int slot) : pool(owner), index(slot) {}
+
+  MCFramePool * pool;
+  int index;
+};
+
+/**
+ * fixed arena of frame slots allocated once at init; Acquire hands out
+ * move-only handles and a free bitmap recycles released slots, so steady
+ * state costs zero allocator calls
+*/
+class MCFramePool {
+public:
+  MCFramePool();
+
+  /**
+   * @brief take a free slot out of the pool
+   * @return handle owning the slot; !Valid() if the pool is exhausted
+  */
+  MCFrameHandle Acquire();
+  /**
+   * @brief number of slots currently free
+  */
+  uint8_t FreeSlots() const;
+  /**
+   * @brief failed Acquire calls since construction
+  */
+  uint32_t Exhausted() const { return exhausted; }
+
+private:
+  friend class MCFrameHandle;
+  void Release(int slot);
+
+  uint8_t slots[MOTCTRL_POOL_SLOTS][MOTCTRL_FRAME_SIZE] MOTCTRL_FRAME_BLOCK_ALIGNED;
+  uint16_t freeMask;   // bit set = slot free
+  uint32_t exhausted;  // failed acquires
+};
+
+/**
+ * command/feedback endpoint of one motor: encodes requests into pooled
+ * frames and decodes responses, keeping buffer ownership out of the
+ * application layer
+*/
+class MotorChannel {
+public:
+  MotorChannel(uint32_t id, MCFramePool & framePool) : canID(id), pool(framePool) {}
+
+  /**
+   * @brief CAN ID of the motor this channel drives
+  */
+  uint32_t CanID() const { return canID; }
+
+  /**
+   * @brief encode a start motor request into a pooled frame
+   * @return handle to the encoded frame; !Valid() if the pool is exhausted
+  */
+  MCFrameHandle StartMotor();
+  /**
+   * @brief encode a stop motor request into a pooled frame
+   * @return handle to the encoded frame; !Valid() if the pool is exhausted
+  */
+  MCFrameHandle StopMotor();
+  /**
+   * @brief encode a torque control request into a pooled frame
+   * @param torque the target torque (in Amper)
+   * @param duration time duration (in ms)
+   * @return handle to the encoded frame; !Valid() if the pool is exhausted
+  */
+  MCFrameHandle TorqueControl(double torque, uint32_t duration);
+  /**
+   * @brief encode a speed control request into a pooled frame
+   * @param speed the target speed (in RAD/s)
+   * @param duration time duration (in ms)
+   * @return handle to the encoded frame; !Valid() if the pool is exhausted
+  */
+  MCFrameHandle SpeedControl(double speed, uint32_t duration);
+  /**
+   * @brief encode a position control request into a pooled frame
+   * @param position the target position (in RAD)
+   * @param duration time duration (in ms)
+   * @return handle to the encoded frame; !Valid() if the pool is exhausted
+  */
+  MCFrameHandle PositionControl(double position, uint32_t duration);
+  /**
+   * @brief decode a response frame received from this motor
+   * @param resBuf response meesage buffer
+   * @param result the decoded response
+   * @return MOTCTRL_RES_SUCCESS if the unpacking is successful
+  */
+  MOTCTRL_RES Decode(uint8_t * resBuf, MCResAny & result);
+
+private:
+  uint32_t canID;
+  MCFramePool & pool;
+};
+
+#endif
@@ -0,0 +1,181 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_confcache.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides a host-side configuration cache with dirty
+  *          tracking for the CyberBeast motor control protocol
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include <stddef.h>
+#include <string.h>
+
+#include "motctrl_confcache.h"
+
+#define MOTCTRL_CONFCACHE_INT_ALL ((((uint64_t)1 << MOTCTRL_CONFCACHE_INT_COUNT)) - 1)
+#define MOTCTRL_CONFCACHE_FLOAT_ALL ((uint8_t)(((uint8_t)1 << MOTCTRL_CONFCACHE_FLOAT_COUNT) - 1))
+
+static MCConfCacheEntry * MCConfCacheFind(MCConfCache & cache, uint32_t canID)
+{
+  for (uint8_t i = 0; i < cache.count; i++) {
+    if (cache.motors[i].canID == canID) {
+      return &cache.motors[i];
+    }
+  }
+  return 0;
+}
+
+static const MCConfCacheEntry * MCConfCacheFind(const MCConfCache & cache, uint32_t canID)
+{
+  for (uint8_t i = 0; i < cache.count; i++) {
+    if (cache.motors[i].canID == canID) {
+      return &cache.motors[i];
+    }
+  }
+  return 0;
+}
+
+static bool MCConfCacheIDValid(MOTCTRL_CONFTYPE confType, MOTCTRL_CONFID confID)
+{
+  if (confType == MOTCTRL_CONFTYPE_INT) {
+    return confID < MOTCTRL_CONFCACHE_INT_COUNT;
+  }
+  return confID < MOTCTRL_CONFCACHE_FLOAT_COUNT;
+}
+
+void MCConfCacheInit(MCConfCache & cache)
+{
+  cache.count = 0;
+}
+
+int MCConfCacheAddMotor(MCConfCache & cache, uint32_t canID)
+{
+  for (uint8_t i = 0; i < cache.count; i++) {
+    if (cache.motors[i].canID == canID) {
+      return i;
+    }
+  }
+  if (cache.count >= MOTCTRL_CONFCACHE_MAX_MOTORS) {
+    return -1;
+  }
+  MCConfCacheEntry & entry = cache.motors[cache.count];
+  memset(&entry, 0, sizeof(entry));
+  entry.canID = canID;
+  entry.intDirtyMask = MOTCTRL_CONFCACHE_INT_ALL;
+  entry.floatDirtyMask = MOTCTRL_CONFCACHE_FLOAT_ALL;
+  return cache.count++;
+}
+
+bool MCConfCacheValidate(MCConfCache & cache, uint32_t canID, uint32_t version)
+{
+  MCConfCacheEntry * entry = MCConfCacheFind(cache, canID);
+  if (entry == 0) {
+    return false;
+  }
+  if (entry->version != version) {
+    // Firmware changed under us: nothing persisted can be trusted
+    entry->version = version;
+    entry->intValidMask = 0;
+    entry->floatValidMask = 0;
+    entry->intDirtyMask = MOTCTRL_CONFCACHE_INT_ALL;
+    entry->floatDirtyMask = MOTCTRL_CONFCACHE_FLOAT_ALL;
+    entry->validated = true;
+    return false;
+  }
+  entry->validated = true;
+  return true;
+}
+
+bool MCConfCacheGet(const MCConfCache & cache, uint32_t canID, MOTCTRL_CONFTYPE confType, MOTCTRL_CONFID confID, double & confData)
+{
+  const MCConfCacheEntry * entry = MCConfCacheFind(cache, canID);
+  if (entry == 0 || !entry->validated || !MCConfCacheIDValid(confType, confID)) {
+    return false;
+  }
+  if (confType == MOTCTRL_CONFTYPE_INT) {
+    uint64_t bit = (uint64_t)1 << confID;
+    if ((entry->intValidMask & bit) == 0 || (entry->intDirtyMask & bit) != 0) {
+      return false;
+    }
+    confData = entry->intValues[confID];
+  } else {
+    uint8_t bit = (uint8_t)(1 << confID);
+    if ((entry->floatValidMask & bit) == 0 || (entry->floatDirtyMask & bit) != 0) {
+      return false;
+    }
+    confData = entry->floatValues[confID];
+  }
+  return true;
+}
+
+void MCConfCacheStore(MCConfCache & cache, uint32_t canID, MOTCTRL_CONFTYPE confType, MOTCTRL_CONFID confID, double confData)
+{
+  MCConfCacheEntry * entry = MCConfCacheFind(cache, canID);
+  if (entry == 0 || !MCConfCacheIDValid(confType, confID)) {
+    return;
+  }
+  if (confType == MOTCTRL_CONFTYPE_INT) {
+    entry->intValues[confID] = confData;
+    entry->intValidMask |= (uint64_t)1 << confID;
+    entry->intDirtyMask &= ~((uint64_t)1 << confID);
+  } else {
+    entry->floatValues[confID] = confData;
+    entry->floatValidMask |= (uint8_t)(1 << confID);
+    entry->floatDirtyMask &= (uint8_t)~(1 << confID);
+  }
+}
+
+void MCConfCacheMarkDirty(MCConfCache & cache, uint32_t canID, MOTCTRL_CONFTYPE confType, MOTCTRL_CONFID confID)
+{
+  MCConfCacheEntry * entry = MCConfCacheFind(cache, canID);
+  if (entry == 0 || !MCConfCacheIDValid(confType, confID)) {
+    return;
+  }
+  if (confType == MOTCTRL_CONFTYPE_INT) {
+    entry->intDirtyMask |= (uint64_t)1 << confID;
+  } else {
+    entry->floatDirtyMask |= (uint8_t)(1 << confID);
+  }
+}
+
+bool MCConfCacheNextDirty(const MCConfCache & cache, uint32_t canID, MOTCTRL_CONFTYPE & confType, MOTCTRL_CONFID & confID)
+{
+  const MCConfCacheEntry * entry = MCConfCacheFind(cache, canID);
+  if (entry == 0) {
+    return false;
+  }
+  for (uint8_t i = 0; i < MOTCTRL_CONFCACHE_INT_COUNT; i++) {
+    if (entry->intDirtyMask & ((uint64_t)1 << i)) {
+      confType = MOTCTRL_CONFTYPE_INT;
+      confID = i;
+      return true;
+    }
+  }
+  for (uint8_t i = 0; i < MOTCTRL_CONFCACHE_FLOAT_COUNT; i++) {
+    if (entry->floatDirtyMask & (uint8_t)(1 << i)) {
+      confType = MOTCTRL_CONFTYPE_FLOAT;
+      confID = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t MCConfCacheChecksum(const MCConfCacheEntry & entry)
+{
+  // 32-bit FNV-1a over the persisted payload, excluding the validated flag
+  uint32_t hash = 2166136261u;
+  const uint8_t * bytes = (const uint8_t *)&entry;
+  size_t payload = offsetof(MCConfCacheEntry, validated);
+  for (size_t i = 0; i < payload; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
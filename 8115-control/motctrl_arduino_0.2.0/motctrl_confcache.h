@@ -0,0 +1,119 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_confcache.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides a host-side configuration cache with dirty
+  *          tracking for the CyberBeast motor control protocol
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_CONFCACHE_H__
+#define _MOTCTRL_CONFCACHE_H__
+
+#include "motctrl_prot.h"
+
+#define MOTCTRL_CONFCACHE_MAX_MOTORS 16
+#define MOTCTRL_CONFCACHE_INT_COUNT 0x21    // confIDs 0x00 .. MOTCTRL_CONFID_INT_OV_TEMP_THRESHOLD
+#define MOTCTRL_CONFCACHE_FLOAT_COUNT 0x06  // confIDs 0x00 .. MOTCTRL_CONFID_FLOAT_AMP_GAIN
+
+/**
+ * cached configuration of one motor; valid bits say a value was read from
+ * the motor at some point, dirty bits say it must be re-fetched before the
+ * cache may answer for it again
+*/
+typedef struct {
+  uint32_t canID;                                     // motor the entry belongs to
+  uint32_t version;                                   // firmware version the values were read under
+  double intValues[MOTCTRL_CONFCACHE_INT_COUNT];      // MOTCTRL_CONFID_INT values
+  double floatValues[MOTCTRL_CONFCACHE_FLOAT_COUNT];  // MOTCTRL_CONFID_FLOAT values
+  uint64_t intValidMask;                              // bit per int confID
+  uint64_t intDirtyMask;                              // bit per int confID
+  uint8_t floatValidMask;                             // bit per float confID
+  uint8_t floatDirtyMask;                             // bit per float confID
+  bool validated;                                     // version confirmed this boot
+} MCConfCacheEntry;
+
+/**
+ * configuration cache over motctrl_prot: the host persists the entries
+ * across power cycles, confirms each motor with one MCReqGetVersion round
+ * trip at boot, and re-fetches only entries marked dirty by a modify --
+ * instead of re-reading every configuration item of every motor
+*/
+typedef struct {
+  MCConfCacheEntry motors[MOTCTRL_CONFCACHE_MAX_MOTORS];
+  uint8_t count;                                      // number of motors in the cache
+} MCConfCache;
+
+/**
+ * @brief initialize an empty cache
+ * @param cache the cache to initialize
+*/
+void MCConfCacheInit(MCConfCache & cache);
+/**
+ * @brief add a motor with an all-dirty entry, or return its existing index
+ * @param cache the cache
+ * @param canID CAN ID of the motor
+ * @return entry index, -1 if the cache is full
+*/
+int MCConfCacheAddMotor(MCConfCache & cache, uint32_t canID);
+/**
+ * @brief confirm a motor's entry against the version from MCResGetVersion;
+ *        a version change invalidates the whole entry (all bits dirty)
+ * @param cache the cache
+ * @param canID CAN ID of the motor
+ * @param version firmware version reported by the motor
+ * @return true if the persisted values are still usable
+*/
+bool MCConfCacheValidate(MCConfCache & cache, uint32_t canID, uint32_t version);
+/**
+ * @brief answer a configuration lookup from the cache
+ * @param cache the cache
+ * @param canID CAN ID of the motor
+ * @param confType the configuration type
+ * @param confID the configuration ID
+ * @param confData the cached value
+ * @return true on a hit; false means the caller must fetch from the motor
+*/
+bool MCConfCacheGet(const MCConfCache & cache, uint32_t canID, MOTCTRL_CONFTYPE confType, MOTCTRL_CONFID confID, double & confData);
+/**
+ * @brief store a value decoded by MCResRetrieveConfiguration, clearing its
+ *        dirty bit
+ * @param cache the cache
+ * @param canID CAN ID of the motor
+ * @param confType the configuration type
+ * @param confID the configuration ID
+ * @param confData the value read from the motor
+*/
+void MCConfCacheStore(MCConfCache & cache, uint32_t canID, MOTCTRL_CONFTYPE confType, MOTCTRL_CONFID confID, double confData);
+/**
+ * @brief mark a value dirty; call alongside every MCReqModifyConfiguration
+ * @param cache the cache
+ * @param canID CAN ID of the motor
+ * @param confType the configuration type
+ * @param confID the configuration ID
+*/
+void MCConfCacheMarkDirty(MCConfCache & cache, uint32_t canID, MOTCTRL_CONFTYPE confType, MOTCTRL_CONFID confID);
+/**
+ * @brief find the next value that must be re-fetched from a motor
+ * @param cache the cache
+ * @param canID CAN ID of the motor
+ * @param confType the configuration type to fetch
+ * @param confID the configuration ID to fetch
+ * @return true if a dirty value was found
+*/
+bool MCConfCacheNextDirty(const MCConfCache & cache, uint32_t canID, MOTCTRL_CONFTYPE & confType, MOTCTRL_CONFID & confID);
+/**
+ * @brief checksum of one entry, for verifying persisted cache images
+ * @param entry the entry to sum
+ * @return 32-bit FNV-1a over values, masks and version
+*/
+uint32_t MCConfCacheChecksum(const MCConfCacheEntry & entry);
+
+#endif
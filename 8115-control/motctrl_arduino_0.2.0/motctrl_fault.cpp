@@ -0,0 +1,128 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_fault.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides sticky fault-state caching with event-driven
+  *          fault notifications for CyberBeast motors
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include "motctrl_fault.h"
+
+static MCFaultEntry * MCFaultFind(MCFaultSupervisor & supervisor, uint32_t canID)
+{
+  for (uint8_t i = 0; i < supervisor.count; i++) {
+    if (supervisor.motors[i].canID == canID) {
+      return &supervisor.motors[i];
+    }
+  }
+  return 0;
+}
+
+void MCFaultInit(MCFaultSupervisor & supervisor, MCFaultCallback callback, void * userData)
+{
+  supervisor.count = 0;
+  supervisor.tempLimit = MOTCTRL_FAULT_TEMP_LIMIT;
+  supervisor.callback = callback;
+  supervisor.userData = userData;
+  supervisor.escalations = 0;
+  supervisor.notifications = 0;
+}
+
+int MCFaultAddMotor(MCFaultSupervisor & supervisor, uint32_t canID)
+{
+  if (supervisor.count >= MOTCTRL_FAULT_MAX_MOTORS) {
+    return -1;
+  }
+  MCFaultEntry * entry = &supervisor.motors[supervisor.count];
+  entry->canID = canID;
+  entry->faultNo = MOTCTRL_FAULTNO_NONE;
+  entry->queryDue = false;
+  return supervisor.count++;
+}
+
+MOTCTRL_FAULTNO MCFaultCurrent(const MCFaultSupervisor & supervisor, uint32_t canID)
+{
+  for (uint8_t i = 0; i < supervisor.count; i++) {
+    if (supervisor.motors[i].canID == canID) {
+      return supervisor.motors[i].faultNo;
+    }
+  }
+  return MOTCTRL_FAULTNO_NONE;
+}
+
+bool MCFaultOnFeedback(MCFaultSupervisor & supervisor, uint32_t canID, const uint8_t * resBuf)
+{
+  if (resBuf == 0) {
+    return false;
+  }
+  MCFrameView v = { resBuf };
+  uint8_t cmd = v.U8(0);
+  if (cmd != MOTCTRL_CMD_TORQUE_CONTROL && cmd != MOTCTRL_CMD_SPEED_CONTROL &&
+      cmd != MOTCTRL_CMD_POSITION_CONTROL) {
+    return false;
+  }
+  MCFaultEntry * entry = MCFaultFind(supervisor, canID);
+  if (entry == 0) {
+    return false;
+  }
+
+  // Escalate on disagreement only: an anomalous frame while the cache says
+  // fault-free means a new fault, a clean frame while the cache holds a
+  // fault means it may have cleared. Agreement costs no bus traffic.
+  bool anomalous = v.U8(1) != MOTCTRL_RES_SUCCESS ||
+                   (int8_t)v.U8(2) >= supervisor.tempLimit;
+  bool faulted = entry->faultNo != MOTCTRL_FAULTNO_NONE;
+  if (anomalous != faulted && !entry->queryDue) {
+    entry->queryDue = true;
+  }
+  return entry->queryDue;
+}
+
+bool MCFaultNextQuery(MCFaultSupervisor & supervisor, uint32_t & canID, uint8_t * reqBuf)
+{
+  for (uint8_t i = 0; i < supervisor.count; i++) {
+    MCFaultEntry * entry = &supervisor.motors[i];
+    if (!entry->queryDue) {
+      continue;
+    }
+    entry->queryDue = false;
+    canID = entry->canID;
+    MCReqGetFault(reqBuf);
+    supervisor.escalations++;
+    return true;
+  }
+  return false;
+}
+
+bool MCFaultOnResponse(MCFaultSupervisor & supervisor, uint32_t canID, uint8_t * resBuf)
+{
+  if (resBuf == 0 || resBuf[0] != MOTCTRL_CMD_GET_FAULT) {
+    return false;
+  }
+  MCFaultEntry * entry = MCFaultFind(supervisor, canID);
+  if (entry == 0) {
+    return false;
+  }
+
+  MOTCTRL_FAULTNO faultNo;
+  if (MCResGetFault(resBuf, faultNo) != MOTCTRL_RES_SUCCESS) {
+    return true;  // consumed, but the cache keeps its last confirmed state
+  }
+  if (faultNo != entry->faultNo) {
+    MOTCTRL_FAULTNO previous = entry->faultNo;
+    entry->faultNo = faultNo;
+    supervisor.notifications++;
+    if (supervisor.callback != 0) {
+      supervisor.callback(canID, previous, faultNo, supervisor.userData);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,112 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_fault.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides sticky fault-state caching with event-driven
+  *          fault notifications for CyberBeast motors
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_FAULT_H__
+#define _MOTCTRL_FAULT_H__
+
+#include "motctrl_prot.h"
+
+#define MOTCTRL_FAULT_MAX_MOTORS 16
+
+// temperature at which a feedback frame counts as anomalous, in Centigrade
+#ifndef MOTCTRL_FAULT_TEMP_LIMIT
+#define MOTCTRL_FAULT_TEMP_LIMIT 100
+#endif
+
+/**
+ * edge-triggered change notification; fires once per fault transition,
+ * including the transition back to MOTCTRL_FAULTNO_NONE
+*/
+typedef void (*MCFaultCallback)(uint32_t canID, MOTCTRL_FAULTNO previous, MOTCTRL_FAULTNO current, void * userData);
+
+/**
+ * cached fault state of one motor
+*/
+typedef struct {
+  uint32_t canID;            // motor the entry belongs to
+  MOTCTRL_FAULTNO faultNo;   // last confirmed fault number
+  bool queryDue;             // feedback disagrees with the cache, escalate
+} MCFaultEntry;
+
+/**
+ * fault supervision layer: instead of sweeping every motor with
+ * MCReqGetFault on a timer, fault detection piggybacks on the control
+ * feedback frames already on the bus -- their result and temperature bytes
+ * are checked against the cached fault state, and an explicit MCReqGetFault
+ * is issued only when the two disagree. Steady state costs zero extra
+ * frames and a fault is noticed within one control tick.
+*/
+typedef struct {
+  MCFaultEntry motors[MOTCTRL_FAULT_MAX_MOTORS];
+  uint8_t count;             // number of motors supervised
+  int8_t tempLimit;          // anomaly threshold, in Centigrade
+  MCFaultCallback callback;  // optional change notification
+  void * userData;           // passed through to the callback
+  uint32_t escalations;      // MCReqGetFault frames issued on anomaly
+  uint32_t notifications;    // fault transitions delivered
+} MCFaultSupervisor;
+
+/**
+ * @brief initialize an empty supervisor
+ * @param supervisor the supervisor to initialize
+ * @param callback optional change notification, 0 to poll MCFaultCurrent
+ * @param userData opaque pointer handed to the callback
+*/
+void MCFaultInit(MCFaultSupervisor & supervisor, MCFaultCallback callback, void * userData);
+/**
+ * @brief register a motor, assumed fault-free until a response says otherwise
+ * @param supervisor the supervisor
+ * @param canID CAN ID of the motor
+ * @return entry index, -1 when the table is full
+*/
+int MCFaultAddMotor(MCFaultSupervisor & supervisor, uint32_t canID);
+/**
+ * @brief cached fault number of a motor
+ * @param supervisor the supervisor
+ * @param canID CAN ID of the motor
+ * @return last confirmed fault number, MOTCTRL_FAULTNO_NONE for unknown motors
+*/
+MOTCTRL_FAULTNO MCFaultCurrent(const MCFaultSupervisor & supervisor, uint32_t canID);
+/**
+ * @brief inspect a control feedback frame for fault symptoms; a failed
+ *        result byte or an over-limit temperature while the cache says
+ *        fault-free -- or a clean frame while the cache holds a fault --
+ *        arms an escalation for the motor
+ * @param supervisor the supervisor
+ * @param canID CAN ID the frame came from
+ * @param resBuf response meesage buffer (torque / speed / position control)
+ * @return true when an escalation is now due for this motor
+*/
+bool MCFaultOnFeedback(MCFaultSupervisor & supervisor, uint32_t canID, const uint8_t * resBuf);
+/**
+ * @brief encode the next due MCReqGetFault escalation, if any
+ * @param supervisor the supervisor
+ * @param canID receives the CAN ID to send the frame to
+ * @param reqBuf command message buffer
+ * @return true when a frame was encoded
+*/
+bool MCFaultNextQuery(MCFaultSupervisor & supervisor, uint32_t & canID, uint8_t * reqBuf);
+/**
+ * @brief consume a get fault response and update the cache; fires the
+ *        callback on a fault transition
+ * @param supervisor the supervisor
+ * @param canID CAN ID the frame came from
+ * @param resBuf response meesage buffer
+ * @return true if the frame was a get fault response for a supervised motor
+*/
+bool MCFaultOnResponse(MCFaultSupervisor & supervisor, uint32_t canID, uint8_t * resBuf);
+
+#endif
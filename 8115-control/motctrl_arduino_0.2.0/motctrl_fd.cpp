@@ -0,0 +1,114 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_fd.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides CAN-FD frame packing for batched commands and
+  *          telemetry snapshots over the CyberBeast motor control protocol
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include <string.h>
+
+#include "motctrl_fd.h"
+
+/**
+ * Telemetry payload layout:
+ *   byte 0        MOTCTRL_FD_CMD_TELEMETRY
+ *   byte 1        indicator pair count
+ *   byte 2        temperature
+ *   bytes 3..14   position, speed, torque as little-endian float32
+ *   bytes 15..    indicator pairs, 1 ID byte + little-endian float32 each
+*/
+#define MOTCTRL_FD_TELEMETRY_HEADER 15
+#define MOTCTRL_FD_TELEMETRY_PAIR 5
+
+static inline void MCFdPutF32(uint8_t * buf, float val)
+{
+  uint32_t bits;
+  memcpy(&bits, &val, sizeof(bits));
+  buf[0] = (uint8_t)bits;
+  buf[1] = (uint8_t)(bits >> 8);
+  buf[2] = (uint8_t)(bits >> 16);
+  buf[3] = (uint8_t)(bits >> 24);
+}
+
+uint32_t MCFdPackCommands(uint8_t * fdBuf, const uint8_t * frameBlock, uint32_t count)
+{
+  if (fdBuf == 0 || frameBlock == 0 || count == 0 || count > MOTCTRL_FD_SLOTS - 1) {
+    return 0;
+  }
+  memset(fdBuf, 0, MOTCTRL_FD_FRAME_SIZE);
+  // Slot 0 is the batch marker so a receiver can tell FD containers from
+  // classic frames by the first byte alone
+  fdBuf[0] = MOTCTRL_FD_CMD_BATCH;
+  fdBuf[1] = (uint8_t)count;
+  memcpy(&fdBuf[MOTCTRL_FRAME_SIZE], frameBlock, count * MOTCTRL_FRAME_SIZE);
+  return (count + 1) * MOTCTRL_FRAME_SIZE;
+}
+
+uint32_t MCFdCommandCount(const uint8_t * fdBuf)
+{
+  if (fdBuf == 0 || fdBuf[0] != MOTCTRL_FD_CMD_BATCH) {
+    return 0;
+  }
+  uint32_t count = fdBuf[1];
+  return count <= MOTCTRL_FD_SLOTS - 1 ? count : 0;
+}
+
+uint8_t * MCFdCommandAt(uint8_t * fdBuf, uint32_t index)
+{
+  if (index >= MCFdCommandCount(fdBuf)) {
+    return 0;
+  }
+  return &fdBuf[(index + 1) * MOTCTRL_FRAME_SIZE];
+}
+
+uint32_t MCFdPackTelemetry(uint8_t * fdBuf, const MCFdTelemetry & telemetry)
+{
+  if (fdBuf == 0 || telemetry.indiCount > MOTCTRL_FD_TELEMETRY_MAX_INDI) {
+    return 0;
+  }
+  uint32_t used = MOTCTRL_FD_TELEMETRY_HEADER + (uint32_t)telemetry.indiCount * MOTCTRL_FD_TELEMETRY_PAIR;
+  if (used > MOTCTRL_FD_FRAME_SIZE) {
+    return 0;
+  }
+  memset(fdBuf, 0, MOTCTRL_FD_FRAME_SIZE);
+  fdBuf[0] = MOTCTRL_FD_CMD_TELEMETRY;
+  fdBuf[1] = telemetry.indiCount;
+  fdBuf[2] = (uint8_t)telemetry.temp;
+  MCFdPutF32(&fdBuf[3], (float)telemetry.position);
+  MCFdPutF32(&fdBuf[7], (float)telemetry.speed);
+  MCFdPutF32(&fdBuf[11], (float)telemetry.torque);
+  for (uint8_t i = 0; i < telemetry.indiCount; i++) {
+    uint8_t * pair = &fdBuf[MOTCTRL_FD_TELEMETRY_HEADER + (uint32_t)i * MOTCTRL_FD_TELEMETRY_PAIR];
+    pair[0] = telemetry.indiIDs[i];
+    MCFdPutF32(&pair[1], (float)telemetry.indiValues[i]);
+  }
+  return used;
+}
+
+MOTCTRL_RES MCFdUnpackTelemetry(uint8_t * fdBuf, MCFdTelemetry & telemetry)
+{
+  if (fdBuf == 0 || fdBuf[0] != MOTCTRL_FD_CMD_TELEMETRY || fdBuf[1] > MOTCTRL_FD_TELEMETRY_MAX_INDI) {
+    return MOTCTRL_RES_FAIL;
+  }
+  MCFrameView view = { fdBuf };
+  telemetry.indiCount = view.U8(1);
+  telemetry.temp = (int8_t)view.U8(2);
+  telemetry.position = view.F32(3);
+  telemetry.speed = view.F32(7);
+  telemetry.torque = view.F32(11);
+  for (uint8_t i = 0; i < telemetry.indiCount; i++) {
+    uint32_t pair = MOTCTRL_FD_TELEMETRY_HEADER + (uint32_t)i * MOTCTRL_FD_TELEMETRY_PAIR;
+    telemetry.indiIDs[i] = view.U8(pair);
+    telemetry.indiValues[i] = view.F32(pair + 1);
+  }
+  return MOTCTRL_RES_SUCCESS;
+}
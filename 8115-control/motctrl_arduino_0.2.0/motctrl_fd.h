@@ -0,0 +1,90 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_fd.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides CAN-FD frame packing for batched commands and
+  *          telemetry snapshots over the CyberBeast motor control protocol
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_FD_H__
+#define _MOTCTRL_FD_H__
+
+#include "motctrl_prot.h"
+
+/**
+ * FD payload size, fixed at the CAN-FD maximum. The layouts below need the
+ * room (the telemetry header alone is 15 bytes), so this is not a tunable;
+ * transports without FD keep using the classic encoders directly.
+*/
+#define MOTCTRL_FD_FRAME_SIZE 64
+
+#define MOTCTRL_FD_SLOTS (MOTCTRL_FD_FRAME_SIZE / MOTCTRL_FRAME_SIZE)
+
+// Container command bytes, outside the classic 0x81..0xB4 range
+#define MOTCTRL_FD_CMD_BATCH 0xC1      // slot 0 carries this marker frame
+#define MOTCTRL_FD_CMD_TELEMETRY 0xC2  // full telemetry snapshot payload
+
+#define MOTCTRL_FD_TELEMETRY_MAX_INDI 9
+
+/**
+ * one decoded telemetry snapshot: the classic feedback quartet plus a set
+ * of indicator values, all carried in a single FD frame
+*/
+typedef struct {
+  int8_t temp;                                       // temperature in Centigrade
+  double position;                                   // in RAD
+  double speed;                                      // in RAD/s
+  double torque;                                     // in Amper
+  uint8_t indiCount;                                 // number of valid indicator pairs
+  uint8_t indiIDs[MOTCTRL_FD_TELEMETRY_MAX_INDI];    // MOTCTRL_INDIID of each pair
+  double indiValues[MOTCTRL_FD_TELEMETRY_MAX_INDI];  // value of each pair
+} MCFdTelemetry;
+
+/**
+ * @brief pack classic command frames into one FD payload; slot 0 is a batch
+ *        marker carrying the command count, unused slots are zeroed
+ * @param fdBuf destination payload of MOTCTRL_FD_FRAME_SIZE bytes
+ * @param frameBlock source block of count * MOTCTRL_FRAME_SIZE bytes, e.g.
+ *        from MCReqPositionControlBatch
+ * @param count number of classic frames, at most MOTCTRL_FD_SLOTS - 1
+ * @return bytes used in fdBuf, 0 if count does not fit
+*/
+uint32_t MCFdPackCommands(uint8_t * fdBuf, const uint8_t * frameBlock, uint32_t count);
+/**
+ * @brief number of classic command frames carried by an FD payload
+ * @param fdBuf the received payload
+ * @return command count, 0 if the payload is not a batch
+*/
+uint32_t MCFdCommandCount(const uint8_t * fdBuf);
+/**
+ * @brief access one classic command frame embedded in an FD payload; feed
+ *        the result to the classic decoders or MCResDispatch
+ * @param fdBuf the received payload
+ * @param index command index, 0 .. MCFdCommandCount() - 1
+ * @return pointer to the 8-byte frame, 0 if index is out of range
+*/
+uint8_t * MCFdCommandAt(uint8_t * fdBuf, uint32_t index);
+/**
+ * @brief pack a telemetry snapshot into one FD payload
+ * @param fdBuf destination payload of MOTCTRL_FD_FRAME_SIZE bytes
+ * @param telemetry the snapshot to pack
+ * @return bytes used in fdBuf, 0 if the snapshot does not fit
+*/
+uint32_t MCFdPackTelemetry(uint8_t * fdBuf, const MCFdTelemetry & telemetry);
+/**
+ * @brief unpack a telemetry snapshot from an FD payload
+ * @param fdBuf the received payload
+ * @param telemetry the unpacked snapshot
+ * @return MOTCTRL_RES_SUCCESS if the unpacking is successful
+*/
+MOTCTRL_RES MCFdUnpackTelemetry(uint8_t * fdBuf, MCFdTelemetry & telemetry);
+
+#endif
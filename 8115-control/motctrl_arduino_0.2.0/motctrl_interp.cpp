@@ -0,0 +1,135 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_interp.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides setpoint interpolation from planner rate to
+  *          bus rate with delta-compressed frame emission
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include "motctrl_interp.h"
+
+static MCInterpMotor * MCInterpFind(MCInterpStream & stream, uint32_t canID)
+{
+  for (uint8_t i = 0; i < stream.count; i++) {
+    if (stream.motors[i].canID == canID) {
+      return &stream.motors[i];
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief interpolated position of a motor at the current tick
+ * @param stream the stage
+ * @param motor the motor
+ * @return position in RAD; holds toPos once the segment is consumed
+*/
+static double MCInterpEval(const MCInterpStream & stream, const MCInterpMotor * motor)
+{
+  if (motor->tickInSeg >= stream.ratio) {
+    return motor->toPos;
+  }
+  double s = (double)motor->tickInSeg / stream.ratio;
+  if (stream.mode == MOTCTRL_INTERP_CUBIC) {
+    // Causal Hermite: the entry tangent is the previous segment's slope,
+    // the exit tangent the current one, both in per-segment units. No
+    // future target is needed, so latency stays at zero planner ticks.
+    double m0 = motor->fromPos - motor->prevPos;
+    double m1 = motor->toPos - motor->fromPos;
+    double s2 = s * s;
+    double s3 = s2 * s;
+    return (2 * s3 - 3 * s2 + 1) * motor->fromPos +
+           (s3 - 2 * s2 + s) * m0 +
+           (-2 * s3 + 3 * s2) * motor->toPos +
+           (s3 - s2) * m1;
+  }
+  return motor->fromPos + (motor->toPos - motor->fromPos) * s;
+}
+
+void MCInterpInit(MCInterpStream & stream, uint32_t ratio, MOTCTRL_INTERP_MODE mode)
+{
+  stream.count = 0;
+  stream.mode = (uint8_t)mode;
+  stream.ratio = ratio < 1 ? 1 : ratio;
+  stream.emitted = 0;
+  stream.skipped = 0;
+}
+
+int MCInterpAddMotor(MCInterpStream & stream, uint32_t canID)
+{
+  if (stream.count >= MOTCTRL_INTERP_MAX_MOTORS) {
+    return -1;
+  }
+  MCInterpMotor * motor = &stream.motors[stream.count];
+  motor->canID = canID;
+  motor->prevPos = 0;
+  motor->fromPos = 0;
+  motor->toPos = 0;
+  motor->tickInSeg = 0;
+  motor->lastSent = 0;
+  motor->hasTarget = false;
+  motor->hasLast = false;
+  return stream.count++;
+}
+
+bool MCInterpSetTarget(MCInterpStream & stream, uint32_t canID, double position)
+{
+  MCInterpMotor * motor = MCInterpFind(stream, canID);
+  if (motor == 0) {
+    return false;
+  }
+  if (!motor->hasTarget) {
+    // First target: jump straight there, no history to interpolate over
+    motor->prevPos = position;
+    motor->fromPos = position;
+  } else {
+    // New segment starts where the previous one currently stands, so a
+    // target arriving mid-segment bends the path instead of stepping it
+    motor->prevPos = motor->fromPos;
+    motor->fromPos = MCInterpEval(stream, motor);
+  }
+  motor->toPos = position;
+  motor->tickInSeg = 0;
+  motor->hasTarget = true;
+  return true;
+}
+
+uint32_t MCInterpTick(MCInterpStream & stream, MCBatchEntry * entries, uint32_t maxEntries, uint32_t duration)
+{
+  uint32_t filled = 0;
+  for (uint8_t i = 0; i < stream.count && filled < maxEntries; i++) {
+    MCInterpMotor * motor = &stream.motors[i];
+    if (!motor->hasTarget) {
+      continue;
+    }
+    if (motor->tickInSeg < stream.ratio) {
+      motor->tickInSeg++;
+    }
+    double position = MCInterpEval(stream, motor);
+
+    // Deadband: a move smaller than the 16-bit position quantum encodes to
+    // the same frame the motor already holds, so sending it is pure load
+    double delta = position - motor->lastSent;
+    if (motor->hasLast && delta < MOTCTRL_POS_SCALE && delta > -MOTCTRL_POS_SCALE) {
+      stream.skipped++;
+      continue;
+    }
+
+    entries[filled].canID = motor->canID;
+    entries[filled].setpoint = position;
+    entries[filled].duration = duration;
+    filled++;
+    motor->lastSent = position;
+    motor->hasLast = true;
+    stream.emitted++;
+  }
+  return filled;
+}
@@ -0,0 +1,98 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_interp.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides setpoint interpolation from planner rate to
+  *          bus rate with delta-compressed frame emission
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_INTERP_H__
+#define _MOTCTRL_INTERP_H__
+
+#include "motctrl_prot.h"
+
+#define MOTCTRL_INTERP_MAX_MOTORS 16
+
+/**
+ * interpolation shape between two planner targets
+*/
+typedef enum {
+  MOTCTRL_INTERP_LINEAR = 0,
+  MOTCTRL_INTERP_CUBIC = 1,    // causal Hermite, tangents from adjacent targets
+} MOTCTRL_INTERP_MODE;
+
+/**
+ * interpolation state of one motor
+*/
+typedef struct {
+  uint32_t canID;      // motor the entry belongs to
+  double prevPos;      // target before fromPos, for the cubic entry tangent
+  double fromPos;      // segment start position, in RAD
+  double toPos;        // segment end position (latest planner target), in RAD
+  uint32_t tickInSeg;  // bus ticks consumed of the current segment
+  double lastSent;     // last position actually emitted
+  bool hasTarget;      // at least one planner target received
+  bool hasLast;        // lastSent is valid
+} MCInterpMotor;
+
+/**
+ * interpolation stage in front of the batch encoder: planner-rate position
+ * targets are resampled to the bus rate (ratio bus ticks per planner tick)
+ * and a frame is emitted only when the interpolated target has moved at
+ * least one position quantum (MOTCTRL_POS_SCALE, the resolution of the
+ * 16-bit position field) away from the last value sent -- a steady hold
+ * produces no traffic at all
+*/
+typedef struct {
+  MCInterpMotor motors[MOTCTRL_INTERP_MAX_MOTORS];
+  uint8_t count;       // number of motors in the stage
+  uint8_t mode;        // @ref MOTCTRL_INTERP_MODE
+  uint32_t ratio;      // bus ticks per planner tick, e.g. 4 for 250 Hz -> 1 kHz
+  uint32_t emitted;    // entries handed to the batch encoder
+  uint32_t skipped;    // ticks suppressed by the quantum deadband
+} MCInterpStream;
+
+/**
+ * @brief initialize an empty interpolation stage
+ * @param stream the stage to initialize
+ * @param ratio bus ticks per planner tick, at least 1
+ * @param mode interpolation shape
+*/
+void MCInterpInit(MCInterpStream & stream, uint32_t ratio, MOTCTRL_INTERP_MODE mode);
+/**
+ * @brief register a motor
+ * @param stream the stage
+ * @param canID CAN ID of the motor
+ * @return entry index, -1 when the table is full
+*/
+int MCInterpAddMotor(MCInterpStream & stream, uint32_t canID);
+/**
+ * @brief push one planner-rate target; starts a new segment from the
+ *        current interpolated position
+ * @param stream the stage
+ * @param canID CAN ID of the motor
+ * @param position target position in RAD
+ * @return true if the motor is registered
+*/
+bool MCInterpSetTarget(MCInterpStream & stream, uint32_t canID, double position);
+/**
+ * @brief advance every motor by one bus tick and collect the entries whose
+ *        interpolated target moved at least one position quantum; hand the
+ *        result to MCReqPositionControlBatch
+ * @param stream the stage
+ * @param entries receives the due entries
+ * @param maxEntries capacity of entries
+ * @param duration duration in ms packed into each entry
+ * @return number of entries filled
+*/
+uint32_t MCInterpTick(MCInterpStream & stream, MCBatchEntry * entries, uint32_t maxEntries, uint32_t duration);
+
+#endif
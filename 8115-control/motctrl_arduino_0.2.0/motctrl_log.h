@@ -0,0 +1,131 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_log.h
+  * @author  LYH, CyberBeast
+  * @brief   This file defines a memory-mappable binary log format for
+  *          recorded motctrl and safety-node CAN traffic
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  * A log file is one MCLogHeader followed by fixed-width MCLogRecords,
+  * written append-only. Analysis tools mmap the file, check the header, and
+  * hand the record array straight to MCBulkDecodeFeedbackEx with
+  * MOTCTRL_LOG_RECORD_SIZE as the stride -- no parsing, no copies. All
+  * fields are little-endian, matching the wire format.
+  */
+#ifndef _MOTCTRL_LOG_H__
+#define _MOTCTRL_LOG_H__
+
+#include <stddef.h>
+
+#include "motctrl_prot.h"
+
+#define MOTCTRL_LOG_MAGIC 0x4C43544D  // "MTCL" when read as little-endian bytes
+#define MOTCTRL_LOG_VERSION 1
+#define MOTCTRL_LOG_RECORD_SIZE 24
+
+// flags field layout
+#define MOTCTRL_LOG_FLAG_DLC_MASK 0x000F  // frame data length
+#define MOTCTRL_LOG_FLAG_TX 0x0010        // set for transmitted frames, clear for received
+
+/**
+ * file header, 8 bytes; recordSize lets readers skip files written by a
+ * newer layout instead of misreading them
+*/
+typedef struct {
+  uint32_t magic;       // MOTCTRL_LOG_MAGIC
+  uint16_t version;     // MOTCTRL_LOG_VERSION
+  uint16_t recordSize;  // MOTCTRL_LOG_RECORD_SIZE
+} MCLogHeader;
+
+/**
+ * one captured frame, 24 bytes with every field naturally aligned so the
+ * record array can be indexed in place after mmap
+*/
+typedef struct {
+  uint64_t timestampUs;              // capture time, monotonic us
+  uint16_t busID;                    // which bus the frame was seen on
+  uint16_t flags;                    // @ref MOTCTRL_LOG_FLAG_*
+  uint32_t canID;                    // CAN arbitration ID
+  uint8_t frame[MOTCTRL_FRAME_SIZE]; // raw frame payload, zero padded
+} MCLogRecord;
+
+static_assert(sizeof(MCLogHeader) == 8, "MCLogHeader must stay 8 bytes");
+static_assert(sizeof(MCLogRecord) == MOTCTRL_LOG_RECORD_SIZE, "MCLogRecord must stay fixed width");
+static_assert(offsetof(MCLogRecord, frame) == 16, "frame offset is part of the format");
+
+/**
+ * @brief fill a file header for a new log
+ * @param header the header to fill
+*/
+static inline void MCLogFillHeader(MCLogHeader * header)
+{
+  header->magic = MOTCTRL_LOG_MAGIC;
+  header->version = MOTCTRL_LOG_VERSION;
+  header->recordSize = MOTCTRL_LOG_RECORD_SIZE;
+}
+
+/**
+ * @brief validate the header of a mapped log file
+ * @param header start of the mapping
+ * @return true if the file uses this layout
+*/
+static inline bool MCLogCheckHeader(const MCLogHeader * header)
+{
+  return header->magic == MOTCTRL_LOG_MAGIC &&
+         header->version == MOTCTRL_LOG_VERSION &&
+         header->recordSize == MOTCTRL_LOG_RECORD_SIZE;
+}
+
+/**
+ * @brief fill one record; the writer appends the struct bytes as-is
+ * @param record the record to fill
+ * @param timestampUs capture time in monotonic us
+ * @param busID bus the frame was seen on
+ * @param canID CAN arbitration ID
+ * @param frame frame payload
+ * @param len payload length, at most MOTCTRL_FRAME_SIZE
+ * @param tx true for transmitted frames
+*/
+static inline void MCLogFillRecord(MCLogRecord * record, uint64_t timestampUs, uint16_t busID,
+                                   uint32_t canID, const uint8_t * frame, uint8_t len, bool tx)
+{
+  record->timestampUs = timestampUs;
+  record->busID = busID;
+  record->flags = (uint16_t)((len & MOTCTRL_LOG_FLAG_DLC_MASK) | (tx ? MOTCTRL_LOG_FLAG_TX : 0));
+  record->canID = canID;
+  for (uint8_t i = 0; i < MOTCTRL_FRAME_SIZE; i++) {
+    record->frame[i] = i < len ? frame[i] : 0;
+  }
+}
+
+/**
+ * @brief record array of a mapped log file
+ * @param mapped start of the mapping (the header)
+ * @return pointer to the first record
+*/
+static inline const MCLogRecord * MCLogRecords(const void * mapped)
+{
+  return (const MCLogRecord *)((const uint8_t *)mapped + sizeof(MCLogHeader));
+}
+
+/**
+ * @brief number of complete records in a mapped log file
+ * @param fileSize size of the file in bytes
+ * @return record count, 0 if the file holds no complete record
+*/
+static inline uint32_t MCLogRecordCount(size_t fileSize)
+{
+  if (fileSize < sizeof(MCLogHeader)) {
+    return 0;
+  }
+  return (uint32_t)((fileSize - sizeof(MCLogHeader)) / MOTCTRL_LOG_RECORD_SIZE);
+}
+
+#endif
@@ -0,0 +1,137 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_perf.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides cycle-counter instrumentation for CyberBeast
+  *          motor control hot paths
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_PERF_H__
+#define _MOTCTRL_PERF_H__
+
+#include <stdint.h>
+
+/**
+ * Fixed-memory cycle statistics: count/min/max/sum plus a log2 histogram
+ * from which percentiles are estimated. Recording is one cycle-counter
+ * read, a handful of integer ops and no locks or allocation, so the
+ * counters can stay on in production.
+ *
+ * Instrumentation is compiled in only when MOTCTRL_PERF_ENABLE is defined;
+ * without it the scope macros expand to nothing. The cycle source can be
+ * overridden by defining MOTCTRL_PERF_CYCLE_SOURCE to a function returning
+ * a free-running uint32_t counter.
+*/
+
+#define MOTCTRL_PERF_BUCKETS 32
+
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t buckets[MOTCTRL_PERF_BUCKETS];  // bucket i counts samples with floor(log2(cycles)) == i
+} MCPerfStat;
+
+/**
+ * @brief read the free-running CPU cycle counter
+ * @return current cycle count, 0 when no counter is available on the target
+*/
+static inline uint32_t MCPerfCycles(void)
+{
+#if defined(MOTCTRL_PERF_CYCLE_SOURCE)
+  return MOTCTRL_PERF_CYCLE_SOURCE();
+#elif defined(__XTENSA__)
+  uint32_t ccount;
+  __asm__ __volatile__("rsr.ccount %0" : "=a"(ccount));
+  return ccount;
+#elif defined(__arm__) && defined(__CORTEX_M) && (__CORTEX_M >= 3)
+  return *(volatile uint32_t *)0xE0001004;  // DWT->CYCCNT
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief reset a statistics record
+ * @param stat the record to reset
+*/
+static inline void MCPerfReset(MCPerfStat * stat)
+{
+  stat->count = 0;
+  stat->min = 0;
+  stat->max = 0;
+  stat->sum = 0;
+  for (uint8_t i = 0; i < MOTCTRL_PERF_BUCKETS; i++) {
+    stat->buckets[i] = 0;
+  }
+}
+
+/**
+ * @brief record one sample
+ * @param stat the record to update
+ * @param cycles measured duration in cycles
+*/
+static inline void MCPerfRecord(MCPerfStat * stat, uint32_t cycles)
+{
+  stat->count++;
+  stat->sum += cycles;
+  if (stat->count == 1 || cycles < stat->min) {
+    stat->min = cycles;
+  }
+  if (cycles > stat->max) {
+    stat->max = cycles;
+  }
+  stat->buckets[31 - __builtin_clz(cycles | 1)]++;
+}
+
+/**
+ * @brief estimate a percentile from the log2 histogram
+ * @param stat the record to query
+ * @param percent percentile to estimate, e.g. 99
+ * @return upper bound in cycles of the bucket holding the percentile, 0 when empty
+*/
+static inline uint32_t MCPerfPercentile(const MCPerfStat * stat, uint8_t percent)
+{
+  if (stat->count == 0) {
+    return 0;
+  }
+  uint64_t threshold = ((uint64_t)stat->count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (uint8_t i = 0; i < MOTCTRL_PERF_BUCKETS; i++) {
+    seen += stat->buckets[i];
+    if (seen >= threshold) {
+      return (i >= 31) ? 0xFFFFFFFF : (((uint32_t)1 << (i + 1)) - 1);
+    }
+  }
+  return stat->max;
+}
+
+#ifdef MOTCTRL_PERF_ENABLE
+
+#define MOTCTRL_PERF_SCOPE_BEGIN() uint32_t _mcperf_t0 = MCPerfCycles()
+#define MOTCTRL_PERF_SCOPE_END(stat) MCPerfRecord((stat), MCPerfCycles() - _mcperf_t0)
+
+/**
+ * aggregate statistics of the protocol hot paths, defined in motctrl_prot.cpp
+*/
+extern MCPerfStat MCPerfEncodeStat;    // MCReq* control encoders
+extern MCPerfStat MCPerfDecodeStat;    // MCRes* control decoders
+extern MCPerfStat MCPerfDispatchStat;  // MCResDispatch
+
+#else
+
+#define MOTCTRL_PERF_SCOPE_BEGIN() do {} while (0)
+#define MOTCTRL_PERF_SCOPE_END(stat) do {} while (0)
+
+#endif
+
+#endif
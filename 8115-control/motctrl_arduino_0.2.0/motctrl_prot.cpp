@@ -14,38 +14,43 @@
   *
   */
 #include "motctrl_prot.h"
+#include "motctrl_perf.h"
 
-typedef enum {
-  MOTCTRL_CMD_RESET_CONFIGURATION = 0x81,
-  MOTCTRL_CMD_REFRESH_CONFIGURATION = 0x82,
-  MOTCTRL_CMD_MODIFY_CONFIGURATION = 0x83,
-  MOTCTRL_CMD_RETRIEVE_CONFIGURATION = 0x84,
-  MOTCTRL_CMD_START_MOTOR = 0x91,
-  MOTCTRL_CMD_STOP_MOTOR = 0x92,
-  MOTCTRL_CMD_TORQUE_CONTROL = 0x93,
-  MOTCTRL_CMD_SPEED_CONTROL = 0x94,
-  MOTCTRL_CMD_POSITION_CONTROL = 0x95,
-  MOTCTRL_CMD_PTS_CONTROL = 0x96,
-  MOTCTRL_CMD_STOP_CONTROL = 0x97,
-  MOTCTRL_CMD_MODIFY_PARAMETER = 0xA1,
-  MOTCTRL_CMD_RETRIEVE_PARAMETER = 0xA2,
-  MOTCTRL_CMD_GET_VERSION = 0xB1,
-  MOTCTRL_CMD_GET_FAULT = 0xB2,
-  MOTCTRL_CMD_ACK_FAULT = 0xB3,
-  MOTCTRL_CMD_RETRIEVE_INDICATOR = 0xB4,
-} MOTCTRL_CMD;
-
-static bool IsBigEndian()
-{
-  union NUM {
-    int32_t a;
-    int8_t b;
-  } num;
-  num.a = 0x1234;
-  if (num.b == 0x12) {
-    return true;
-  }
-  return false;
+#include <string.h>
+
+#ifdef MOTCTRL_PERF_ENABLE
+MCPerfStat MCPerfEncodeStat;
+MCPerfStat MCPerfDecodeStat;
+MCPerfStat MCPerfDispatchStat;
+#endif
+
+/**
+ * The wire format is little-endian. The helpers below resolve host byte
+ * order at compile time: the shift/mask form is endianness-neutral, and on
+ * little-endian targets the compiler folds each call into a single load or
+ * store, so every pack/unpack in this file is straight-line byte moves with
+ * no runtime byte-order check.
+*/
+static inline void MCPutU32(uint8_t * buf, uint32_t val)
+{
+  buf[0] = (uint8_t)(val);
+  buf[1] = (uint8_t)(val >> 8);
+  buf[2] = (uint8_t)(val >> 16);
+  buf[3] = (uint8_t)(val >> 24);
+}
+
+static inline void MCPutU24(uint8_t * buf, uint32_t val)
+{
+  buf[0] = (uint8_t)(val);
+  buf[1] = (uint8_t)(val >> 8);
+  buf[2] = (uint8_t)(val >> 16);
+}
+
+static inline void MCPutF32(uint8_t * buf, float val)
+{
+  uint32_t bits;
+  memcpy(&bits, &val, sizeof(bits));
+  MCPutU32(buf, bits);
 }
 
 void MCReqResetConfiguration(uint8_t * reqBuf)
@@ -91,31 +96,17 @@ void MCReqModifyConfiguration(uint8_t * reqBuf, MOTCTRL_CONFTYPE confType, MOTCT
   reqBuf[1] = (uint8_t)confType;
   reqBuf[2] = (uint8_t)confID;
 
-  uint8_t * confDataPtr = 0;
-  int32_t confDataInt = (int32_t)confData;
   switch (confType) {
     default:
     case MOTCTRL_CONFTYPE_INT: {
-      confDataPtr = (uint8_t *)(&confDataInt);
+      MCPutU32(&reqBuf[4], (uint32_t)(int32_t)confData);
       break;
     }
     case MOTCTRL_CONFTYPE_FLOAT: {
-      confDataPtr = (uint8_t *)(&confData);
+      MCPutF32(&reqBuf[4], (float)confData);
       break;
     }
   }
-  if (IsBigEndian()) {
-    reqBuf[4] = confDataPtr[3];
-    reqBuf[5] = confDataPtr[2];
-    reqBuf[6] = confDataPtr[1];
-    reqBuf[7] = confDataPtr[0];
-  }
-  else {
-    reqBuf[4] = confDataPtr[0];
-    reqBuf[5] = confDataPtr[1];
-    reqBuf[6] = confDataPtr[2];
-    reqBuf[7] = confDataPtr[3];
-  }
 }
 
 MOTCTRL_RES MCResModifyConfiguration(uint8_t * resBuf, MOTCTRL_CONFTYPE & confType, MOTCTRL_CONFID & confID)
@@ -140,39 +131,25 @@ void MCReqRetrieveConfiguration(uint8_t * reqBuf, MOTCTRL_CONFTYPE confType, MOT
 
 MOTCTRL_RES MCResRetrieveConfiguration(uint8_t * resBuf, MOTCTRL_CONFTYPE & confType, MOTCTRL_CONFID & confID, double & confData)
 {
-  if (resBuf == 0 || resBuf[0] != MOTCTRL_CMD_RETRIEVE_CONFIGURATION) {
+  MCFrameView view = { resBuf };
+  if (!view.Is(MOTCTRL_CMD_RETRIEVE_CONFIGURATION)) {
     return MOTCTRL_RES_FAIL;
   }
-  confType = (MOTCTRL_CONFTYPE)resBuf[1];
-  confID = (MOTCTRL_CONFID)resBuf[2];
+  confType = (MOTCTRL_CONFTYPE)view.U8(1);
+  confID = (MOTCTRL_CONFID)view.U8(2);
 
-  uint8_t confDataPtr[4];
-  if (IsBigEndian()) {
-    confDataPtr[0] = resBuf[7];
-    confDataPtr[1] = resBuf[6];
-    confDataPtr[2] = resBuf[5];
-    confDataPtr[3] = resBuf[4];
-  }
-  else {
-    confDataPtr[0] = resBuf[4];
-    confDataPtr[1] = resBuf[5];
-    confDataPtr[2] = resBuf[6];
-    confDataPtr[3] = resBuf[7];
-  }
   switch (confType) {
     default:
     case MOTCTRL_CONFTYPE_INT: {
-      int32_t * confDataInt = (int32_t *)confDataPtr;
-      confData = (double)(*confDataInt);
+      confData = (double)view.I32(4);
       break;
     }
     case MOTCTRL_CONFTYPE_FLOAT: {
-      double * confDataFloat = (double *)confDataPtr;
-      confData = *confDataFloat;
+      confData = (double)view.F32(4);
       break;
     }
   }
-  return (MOTCTRL_RES)resBuf[3];
+  return (MOTCTRL_RES)view.U8(3);
 }
 
 void MCReqStartMotor(uint8_t * reqBuf)
@@ -212,47 +189,67 @@ void MCReqTorqueControl(uint8_t * reqBuf, double torque, uint32_t duration)
   if (reqBuf == 0) {
     return;
   }
+  MOTCTRL_PERF_SCOPE_BEGIN();
   reqBuf[0] = (uint8_t)MOTCTRL_CMD_TORQUE_CONTROL;
-  uint8_t * torquePtr = (uint8_t *)(&torque);
-  uint8_t * durationPtr = (uint8_t *)(&duration);
-  if (IsBigEndian()) {
-    reqBuf[1] = torquePtr[3];
-    reqBuf[2] = torquePtr[2];
-    reqBuf[3] = torquePtr[1];
-    reqBuf[4] = torquePtr[0];
+  MCPutF32(&reqBuf[1], (float)torque);
+  MCPutU24(&reqBuf[5], duration);
+  MOTCTRL_PERF_SCOPE_END(&MCPerfEncodeStat);
+}
 
-    reqBuf[5] = durationPtr[3];
-    reqBuf[6] = durationPtr[2];
-    reqBuf[7] = durationPtr[1];
-  }
-  else {
-    reqBuf[1] = torquePtr[0];
-    reqBuf[2] = torquePtr[1];
-    reqBuf[3] = torquePtr[2];
-    reqBuf[4] = torquePtr[3];
+#ifdef MOTCTRL_DECODE_LUT
+/**
+ * Optional lookup tables for the two 12-bit fields: 4096 floats each, built
+ * once on first decode. Trades 32 KB of RAM for skipping even the
+ * multiply-add, so only enable where memory allows.
+*/
+static float s_speedLut[4096];
+static float s_torqueLut[4096];
+static bool s_decodeLutReady = false;
 
-    reqBuf[5] = torquePtr[0];
-    reqBuf[6] = torquePtr[1];
-    reqBuf[7] = torquePtr[2];
+static void MCDecodeLutInit(void)
+{
+  for (uint16_t i = 0; i < 4096; i++) {
+    s_speedLut[i] = (float)(i * MOTCTRL_SPEED_SCALE - 65);
+    s_torqueLut[i] = (float)(i * MOTCTRL_TORQUE_SCALE - 225);
   }
+  s_decodeLutReady = true;
 }
+#endif
 
-MOTCTRL_RES MCResTorqueControl(uint8_t * resBuf, int8_t & temp, double & position, double & speed, double & torque)
+static MOTCTRL_RES MCResControl(MOTCTRL_CMD cmd, uint8_t * resBuf, int8_t & temp, double & position, double & speed, double & torque)
 {
-  if (resBuf == 0 || resBuf[0] != MOTCTRL_CMD_TORQUE_CONTROL) {
+  MCFrameView view = { resBuf };
+  if (!view.Is(cmd)) {
     return MOTCTRL_RES_FAIL;
   }
-  temp = resBuf[2];
-  int16_t pos_int;
-  uint8_t * tmp = (uint8_t *)&pos_int;
-  tmp[0] = resBuf[3];
-  tmp[1] = resBuf[4];
-  position = (double)pos_int * 25 / 65535 - 12.5; // in RAD, between -12.5 ~ 12.5
-  int16_t speed_int = (int16_t)(((uint16_t)resBuf[5] << 4) | (resBuf[6] >> 4));
-  speed = (double)speed_int * 130 / 4095 - 65; // in RAD/s, between -65 ~ 65
-  int16_t torque_int = (int16_t)(((uint16_t)(resBuf[6] & 0x0F) << 8) | resBuf[7]);
-  torque = (double)torque_int * 450 / 4095 - 225; // in Amper, between -225 ~ 225
-  return (MOTCTRL_RES)resBuf[1];
+#ifdef MOTCTRL_DECODE_LUT
+  if (!s_decodeLutReady) {
+    MCDecodeLutInit();
+  }
+#endif
+  MOTCTRL_PERF_SCOPE_BEGIN();
+  temp = (int8_t)view.U8(2);
+  // The wire field is an unsigned 16-bit offset-binary value: 0x0000 is
+  // -12.5 RAD, 0xFFFF is +12.5 RAD. A signed read here would fold the whole
+  // positive half of the range down by 25 RAD.
+  uint16_t pos_raw = view.U16(3);
+  position = (double)pos_raw * MOTCTRL_POS_SCALE - 12.5; // in RAD, between -12.5 ~ 12.5
+  uint16_t speed_raw = ((uint16_t)view.U8(5) << 4) | (view.U8(6) >> 4);
+  uint16_t torque_raw = ((uint16_t)(view.U8(6) & 0x0F) << 8) | view.U8(7);
+#ifdef MOTCTRL_DECODE_LUT
+  speed = s_speedLut[speed_raw & 0x0FFF]; // in RAD/s, between -65 ~ 65
+  torque = s_torqueLut[torque_raw & 0x0FFF]; // in Amper, between -225 ~ 225
+#else
+  speed = (double)speed_raw * MOTCTRL_SPEED_SCALE - 65; // in RAD/s, between -65 ~ 65
+  torque = (double)torque_raw * MOTCTRL_TORQUE_SCALE - 225; // in Amper, between -225 ~ 225
+#endif
+  MOTCTRL_PERF_SCOPE_END(&MCPerfDecodeStat);
+  return (MOTCTRL_RES)view.U8(1);
+}
+
+MOTCTRL_RES MCResTorqueControl(uint8_t * resBuf, int8_t & temp, double & position, double & speed, double & torque)
+{
+  return MCResControl(MOTCTRL_CMD_TORQUE_CONTROL, resBuf, temp, position, speed, torque);
 }
 
 void MCReqSpeedControl(uint8_t * reqBuf, double speed, uint32_t duration)
@@ -260,47 +257,16 @@ void MCReqSpeedControl(uint8_t * reqBuf, double speed, uint32_t duration)
   if (reqBuf == 0) {
     return;
   }
+  MOTCTRL_PERF_SCOPE_BEGIN();
   reqBuf[0] = (uint8_t)MOTCTRL_CMD_SPEED_CONTROL;
-  uint8_t * speedPtr = (uint8_t *)(&speed);
-  uint8_t * durationPtr = (uint8_t *)(&duration);
-  if (IsBigEndian()) {
-    reqBuf[1] = speedPtr[3];
-    reqBuf[2] = speedPtr[2];
-    reqBuf[3] = speedPtr[1];
-    reqBuf[4] = speedPtr[0];
-
-    reqBuf[5] = durationPtr[3];
-    reqBuf[6] = durationPtr[2];
-    reqBuf[7] = durationPtr[1];
-  }
-  else {
-    reqBuf[1] = speedPtr[0];
-    reqBuf[2] = speedPtr[1];
-    reqBuf[3] = speedPtr[2];
-    reqBuf[4] = speedPtr[3];
-
-    reqBuf[5] = speedPtr[0];
-    reqBuf[6] = speedPtr[1];
-    reqBuf[7] = speedPtr[2];
-  }
+  MCPutF32(&reqBuf[1], (float)speed);
+  MCPutU24(&reqBuf[5], duration);
+  MOTCTRL_PERF_SCOPE_END(&MCPerfEncodeStat);
 }
 
 MOTCTRL_RES MCResSpeedControl(uint8_t * resBuf, int8_t & temp, double & position, double & speed, double & torque)
 {
-  if (resBuf == 0 || resBuf[0] != MOTCTRL_CMD_SPEED_CONTROL) {
-    return MOTCTRL_RES_FAIL;
-  }
-  temp = resBuf[2];
-  int16_t pos_int;
-  uint8_t * tmp = (uint8_t *)&pos_int;
-  tmp[0] = resBuf[3];
-  tmp[1] = resBuf[4];
-  position = (double)pos_int * 25 / 65535 - 12.5; // in RAD, between -12.5 ~ 12.5
-  int16_t speed_int = (int16_t)(((uint16_t)resBuf[5] << 4) | (resBuf[6] >> 4));
-  speed = (double)speed_int * 130 / 4095 - 65; // in RAD/s, between -65 ~ 65
-  int16_t torque_int = (int16_t)(((uint16_t)(resBuf[6] & 0x0F) << 8) | resBuf[7]);
-  torque = (double)torque_int * 450 / 4095 - 225; // in Amper, between -225 ~ 225
-  return (MOTCTRL_RES)resBuf[1];
+  return MCResControl(MOTCTRL_CMD_SPEED_CONTROL, resBuf, temp, position, speed, torque);
 }
 
 void MCReqPositionControl(uint8_t * reqBuf, double position, uint32_t duration)
@@ -308,49 +274,163 @@ void MCReqPositionControl(uint8_t * reqBuf, double position, uint32_t duration)
   if (reqBuf == 0) {
     return;
   }
+  MOTCTRL_PERF_SCOPE_BEGIN();
   reqBuf[0] = (uint8_t)MOTCTRL_CMD_POSITION_CONTROL;
-  uint8_t * posPtr = (uint8_t *)(&position);
-  uint8_t * durationPtr = (uint8_t *)(&duration);
-  if (IsBigEndian()) {
-    reqBuf[1] = posPtr[3];
-    reqBuf[2] = posPtr[2];
-    reqBuf[3] = posPtr[1];
-    reqBuf[4] = posPtr[0];
+  MCPutF32(&reqBuf[1], (float)position);
+  MCPutU24(&reqBuf[5], duration);
+  MOTCTRL_PERF_SCOPE_END(&MCPerfEncodeStat);
+}
 
-    reqBuf[5] = durationPtr[3];
-    reqBuf[6] = durationPtr[2];
-    reqBuf[7] = durationPtr[1];
+MOTCTRL_RES MCResPositionControl(uint8_t * resBuf, int8_t & temp, double & position, double & speed, double & torque)
+{
+  return MCResControl(MOTCTRL_CMD_POSITION_CONTROL, resBuf, temp, position, speed, torque);
+}
+
+/**
+ * Q16.16 multipliers for the raw feedback fields, folded at compile time.
+ * value_q15 = ((raw * MUL) >> 16) - OFFSET gives the physical value in Q15
+ * with sub-LSB error and no floating point or runtime division.
+*/
+#define MOTCTRL_POS_Q15_MUL      ((uint32_t)((25ULL << 31) / 65535))    // 25 RAD over 16 bits
+#define MOTCTRL_POS_Q15_OFFSET   (25L << 14)                            // 12.5 RAD
+#define MOTCTRL_SPEED_Q15_MUL    ((uint32_t)((130ULL << 31) / 4095))    // 130 RAD/s over 12 bits
+#define MOTCTRL_SPEED_Q15_OFFSET (65L << 15)                            // 65 RAD/s
+#define MOTCTRL_TORQUE_Q15_MUL   ((uint32_t)((450ULL << 31) / 4095))    // 450 A over 12 bits
+#define MOTCTRL_TORQUE_Q15_OFFSET (225L << 15)                          // 225 A
+
+static MOTCTRL_RES MCResControlQ15(MOTCTRL_CMD cmd, uint8_t * resBuf, MCFeedbackQ15 & feedback)
+{
+  MCFrameView view = { resBuf };
+  if (!view.Is(cmd)) {
+    return MOTCTRL_RES_FAIL;
   }
-  else {
-    reqBuf[1] = posPtr[0];
-    reqBuf[2] = posPtr[1];
-    reqBuf[3] = posPtr[2];
-    reqBuf[4] = posPtr[3];
+  MOTCTRL_PERF_SCOPE_BEGIN();
+  feedback.temp = (int8_t)view.U8(2);
+  uint16_t pos_raw = view.U16(3);
+  feedback.position = (int32_t)(((uint64_t)pos_raw * MOTCTRL_POS_Q15_MUL) >> 16) - MOTCTRL_POS_Q15_OFFSET;
+  uint16_t speed_raw = ((uint16_t)view.U8(5) << 4) | (view.U8(6) >> 4);
+  feedback.speed = (int32_t)(((uint64_t)speed_raw * MOTCTRL_SPEED_Q15_MUL) >> 16) - MOTCTRL_SPEED_Q15_OFFSET;
+  uint16_t torque_raw = ((uint16_t)(view.U8(6) & 0x0F) << 8) | view.U8(7);
+  feedback.torque = (int32_t)(((uint64_t)torque_raw * MOTCTRL_TORQUE_Q15_MUL) >> 16) - MOTCTRL_TORQUE_Q15_OFFSET;
+  MOTCTRL_PERF_SCOPE_END(&MCPerfDecodeStat);
+  return (MOTCTRL_RES)view.U8(1);
+}
 
-    reqBuf[5] = posPtr[0];
-    reqBuf[6] = posPtr[1];
-    reqBuf[7] = posPtr[2];
+MOTCTRL_RES MCResTorqueControlQ15(uint8_t * resBuf, MCFeedbackQ15 & feedback)
+{
+  return MCResControlQ15(MOTCTRL_CMD_TORQUE_CONTROL, resBuf, feedback);
+}
+
+MOTCTRL_RES MCResSpeedControlQ15(uint8_t * resBuf, MCFeedbackQ15 & feedback)
+{
+  return MCResControlQ15(MOTCTRL_CMD_SPEED_CONTROL, resBuf, feedback);
+}
+
+MOTCTRL_RES MCResPositionControlQ15(uint8_t * resBuf, MCFeedbackQ15 & feedback)
+{
+  return MCResControlQ15(MOTCTRL_CMD_POSITION_CONTROL, resBuf, feedback);
+}
+
+static uint32_t MCReqControlBatch(MOTCTRL_CMD cmd, uint8_t * frameBlock, const MCBatchEntry * entries, uint32_t count)
+{
+  if (frameBlock == 0 || entries == 0) {
+    return 0;
   }
+  uint8_t * frame = frameBlock;
+  for (uint32_t i = 0; i < count; i++) {
+    frame[0] = (uint8_t)cmd;
+    MCPutF32(&frame[1], (float)entries[i].setpoint);
+    MCPutU24(&frame[5], entries[i].duration);
+    frame += MOTCTRL_FRAME_SIZE;
+  }
+  return count * MOTCTRL_FRAME_SIZE;
 }
 
-MOTCTRL_RES MCResPositionControl(uint8_t * resBuf, int8_t & temp, double & position, double & speed, double & torque)
+uint32_t MCReqTorqueControlBatch(uint8_t * frameBlock, const MCBatchEntry * entries, uint32_t count)
+{
+  return MCReqControlBatch(MOTCTRL_CMD_TORQUE_CONTROL, frameBlock, entries, count);
+}
+
+uint32_t MCReqSpeedControlBatch(uint8_t * frameBlock, const MCBatchEntry * entries, uint32_t count)
+{
+  return MCReqControlBatch(MOTCTRL_CMD_SPEED_CONTROL, frameBlock, entries, count);
+}
+
+uint32_t MCReqPositionControlBatch(uint8_t * frameBlock, const MCBatchEntry * entries, uint32_t count)
+{
+  return MCReqControlBatch(MOTCTRL_CMD_POSITION_CONTROL, frameBlock, entries, count);
+}
+
+void MCReqPtsControl(uint8_t * reqBuf, uint8_t seqNo, double position, uint16_t time)
+{
+  if (reqBuf == 0) {
+    return;
+  }
+  reqBuf[0] = (uint8_t)MOTCTRL_CMD_PTS_CONTROL;
+  reqBuf[1] = seqNo;
+  MCPutF32(&reqBuf[2], (float)position);
+  reqBuf[6] = (uint8_t)(time);
+  reqBuf[7] = (uint8_t)(time >> 8);
+}
+
+MOTCTRL_RES MCResPtsControl(uint8_t * resBuf, uint8_t & ackSeq, uint8_t & window)
 {
-  if (resBuf == 0 || resBuf[0] != MOTCTRL_CMD_POSITION_CONTROL) {
+  if (resBuf == 0 || resBuf[0] != MOTCTRL_CMD_PTS_CONTROL) {
     return MOTCTRL_RES_FAIL;
   }
-  temp = resBuf[2];
-  int16_t pos_int;
-  uint8_t * tmp = (uint8_t *)&pos_int;
-  tmp[0] = resBuf[3];
-  tmp[1] = resBuf[4];
-  position = (double)pos_int * 25 / 65535 - 12.5; // in RAD, between -12.5 ~ 12.5
-  int16_t speed_int = (int16_t)(((uint16_t)resBuf[5] << 4) | (resBuf[6] >> 4));
-  speed = (double)speed_int * 130 / 4095 - 65; // in RAD/s, between -65 ~ 65
-  int16_t torque_int = (int16_t)(((uint16_t)(resBuf[6] & 0x0F) << 8) | resBuf[7]);
-  torque = (double)torque_int * 450 / 4095 - 225; // in Amper, between -225 ~ 225
+  ackSeq = resBuf[2];
+  window = resBuf[3];
   return (MOTCTRL_RES)resBuf[1];
 }
 
+void MCPtsStreamInit(MCPtsStream & stream, uint8_t window)
+{
+  stream.head = 0;
+  stream.count = 0;
+  stream.nextSeq = 0;
+  stream.ackSeq = 0;
+  stream.window = window;
+}
+
+bool MCPtsStreamPush(MCPtsStream & stream, double position, uint16_t time)
+{
+  if (stream.count >= MOTCTRL_PTS_BUFFER_KNOTS) {
+    return false;
+  }
+  uint8_t slot = (uint8_t)((stream.head + stream.count) % MOTCTRL_PTS_BUFFER_KNOTS);
+  stream.knots[slot].position = position;
+  stream.knots[slot].time = time;
+  stream.count++;
+  return true;
+}
+
+uint32_t MCPtsStreamPump(MCPtsStream & stream, uint8_t * frameBlock, uint32_t maxFrames)
+{
+  if (frameBlock == 0) {
+    return 0;
+  }
+  uint32_t packed = 0;
+  while (packed < maxFrames && stream.count > 0) {
+    uint8_t inFlight = (uint8_t)(stream.nextSeq - stream.ackSeq);
+    if (inFlight >= stream.window) {
+      break;
+    }
+    MCPtsKnot & knot = stream.knots[stream.head];
+    MCReqPtsControl(frameBlock + packed * MOTCTRL_FRAME_SIZE, stream.nextSeq, knot.position, knot.time);
+    stream.head = (uint8_t)((stream.head + 1) % MOTCTRL_PTS_BUFFER_KNOTS);
+    stream.count--;
+    stream.nextSeq++;
+    packed++;
+  }
+  return packed;
+}
+
+void MCPtsStreamOnAck(MCPtsStream & stream, uint8_t ackSeq, uint8_t window)
+{
+  stream.ackSeq = ackSeq;
+  stream.window = window;
+}
+
 void MCReqStopControl(uint8_t * reqBuf)
 {
   if (reqBuf == 0) {
@@ -375,19 +455,7 @@ void MCReqModifyParameter(uint8_t * reqBuf, MOTCTRL_PARAID paraID, double paraDa
   reqBuf[0] = (uint8_t)MOTCTRL_CMD_MODIFY_PARAMETER;
   reqBuf[1] = (uint8_t)paraID;
 
-  uint8_t * paraDataPtr = (uint8_t *)(&paraData);
-  if (IsBigEndian()) {
-    reqBuf[4] = paraDataPtr[3];
-    reqBuf[5] = paraDataPtr[2];
-    reqBuf[6] = paraDataPtr[1];
-    reqBuf[7] = paraDataPtr[0];
-  }
-  else {
-    reqBuf[4] = paraDataPtr[0];
-    reqBuf[5] = paraDataPtr[1];
-    reqBuf[6] = paraDataPtr[2];
-    reqBuf[7] = paraDataPtr[3];
-  }
+  MCPutF32(&reqBuf[4], (float)paraData);
 }
 
 MOTCTRL_RES MCResModifyParameter(uint8_t * resBuf, MOTCTRL_PARAID & paraID)
@@ -413,24 +481,10 @@ MOTCTRL_RES MCResRetrieveParameter(uint8_t * resBuf, MOTCTRL_PARAID & paraID, do
   if (resBuf == 0 || resBuf[0] != MOTCTRL_CMD_RETRIEVE_PARAMETER) {
     return MOTCTRL_RES_FAIL;
   }
-  paraID = (MOTCTRL_PARAID)resBuf[1];
-
-  uint8_t paraDataPtr[4];
-  if (IsBigEndian()) {
-    paraDataPtr[0] = resBuf[7];
-    paraDataPtr[1] = resBuf[6];
-    paraDataPtr[2] = resBuf[5];
-    paraDataPtr[3] = resBuf[4];
-  }
-  else {
-    paraDataPtr[0] = resBuf[4];
-    paraDataPtr[1] = resBuf[5];
-    paraDataPtr[2] = resBuf[6];
-    paraDataPtr[3] = resBuf[7];
-  }
-  double *paraDataFloat = (double *)paraDataPtr;
-  paraData = *paraDataFloat;
-  return (MOTCTRL_RES)resBuf[2];
+  MCFrameView view = { resBuf };
+  paraID = (MOTCTRL_PARAID)view.U8(1);
+  paraData = (double)view.F32(4);
+  return (MOTCTRL_RES)view.U8(2);
 }
 
 void MCReqGetVersion(uint8_t * reqBuf)
@@ -447,22 +501,9 @@ MOTCTRL_RES MCResGetVersion(uint8_t * resBuf, uint32_t & version)
     return MOTCTRL_RES_FAIL;
   }
 
-  uint8_t versionPtr[4];
-  if (IsBigEndian()) {
-    versionPtr[0] = resBuf[7];
-    versionPtr[1] = resBuf[6];
-    versionPtr[2] = resBuf[5];
-    versionPtr[3] = resBuf[4];
-  }
-  else {
-    versionPtr[0] = resBuf[4];
-    versionPtr[1] = resBuf[5];
-    versionPtr[2] = resBuf[6];
-    versionPtr[3] = resBuf[7];
-  }
-  uint32_t * versionInt = (uint32_t *)versionPtr;
-  version = *versionInt;
-  return (MOTCTRL_RES)resBuf[1];
+  MCFrameView view = { resBuf };
+  version = view.U32(4);
+  return (MOTCTRL_RES)view.U8(1);
 }
 
 void MCReqGetFault(uint8_t * reqBuf)
@@ -514,22 +555,215 @@ MOTCTRL_RES MCResRetrieveIndicator(uint8_t * resBuf, MOTCTRL_INDIID & indiID, do
   if (resBuf == 0 || resBuf[0] != MOTCTRL_CMD_RETRIEVE_INDICATOR) {
     return MOTCTRL_RES_FAIL;
   }
-  indiID = (MOTCTRL_INDIID)resBuf[1];
+  MCFrameView view = { resBuf };
+  indiID = (MOTCTRL_INDIID)view.U8(1);
+  indiData = (double)view.F32(4);
+  return (MOTCTRL_RES)view.U8(2);
+}
+
+/**
+ * bulk requests reuse MOTCTRL_CMD_RETRIEVE_INDICATOR; byte 1 carries the id
+ * count with the high bit set (single requests put the id there, and ids
+ * never exceed 0x15), bytes 2..7 carry the ids. The motor answers with one
+ * single-indicator response frame per id.
+*/
+#define MOTCTRL_INDICATOR_BULK_FLAG 0x80
+
+void MCReqRetrieveIndicatorBulk(uint8_t * reqBuf, const MOTCTRL_INDIID * indiIDs, uint8_t count)
+{
+  if (reqBuf == 0 || indiIDs == 0) {
+    return;
+  }
+  if (count > MOTCTRL_INDICATOR_BULK_MAX) {
+    count = MOTCTRL_INDICATOR_BULK_MAX;
+  }
+  reqBuf[0] = (uint8_t)MOTCTRL_CMD_RETRIEVE_INDICATOR;
+  reqBuf[1] = (uint8_t)(MOTCTRL_INDICATOR_BULK_FLAG | count);
+  for (uint8_t i = 0; i < count; i++) {
+    reqBuf[2 + i] = (uint8_t)indiIDs[i];
+  }
+}
+
+void MCIndicatorSnapshotInit(MCIndicatorSnapshot & snapshot, const MOTCTRL_INDIID * indiIDs, uint8_t count)
+{
+  snapshot.validMask = 0;
+  snapshot.pendingMask = 0;
+  if (indiIDs == 0) {
+    return;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    if ((uint8_t)indiIDs[i] < MOTCTRL_INDIID_COUNT) {
+      snapshot.pendingMask |= (uint32_t)1 << (uint8_t)indiIDs[i];
+    }
+  }
+}
+
+MOTCTRL_RES MCResRetrieveIndicatorBulk(uint8_t * resBuf, MCIndicatorSnapshot & snapshot)
+{
+  MOTCTRL_INDIID indiID;
+  double indiData;
+  MOTCTRL_RES res = MCResRetrieveIndicator(resBuf, indiID, indiData);
+  if (res != MOTCTRL_RES_SUCCESS) {
+    return res;
+  }
+  if ((uint8_t)indiID >= MOTCTRL_INDIID_COUNT) {
+    return MOTCTRL_RES_FAIL_UNKNOWN_ID;
+  }
+  snapshot.values[(uint8_t)indiID] = indiData;
+  snapshot.validMask |= (uint32_t)1 << (uint8_t)indiID;
+  snapshot.pendingMask &= ~((uint32_t)1 << (uint8_t)indiID);
+  return res;
+}
+
+bool MCIndicatorSnapshotComplete(const MCIndicatorSnapshot & snapshot)
+{
+  return snapshot.pendingMask == 0;
+}
+
+/**
+ * single-entry response dispatch: a table indexed by (cmd - first cmd)
+ * routes a frame to its unpacker in O(1), instead of the caller probing
+ * every MCRes* decoder in turn
+*/
+typedef MOTCTRL_RES (*MCResHandler)(uint8_t * resBuf, MCResAny & out);
+
+#define MOTCTRL_CMD_FIRST MOTCTRL_CMD_RESET_CONFIGURATION
+#define MOTCTRL_CMD_LAST MOTCTRL_CMD_RETRIEVE_INDICATOR
+#define MOTCTRL_CMD_SLOTS (MOTCTRL_CMD_LAST - MOTCTRL_CMD_FIRST + 1)
+
+static MOTCTRL_RES MCDispResetConfiguration(uint8_t * resBuf, MCResAny & out)
+{
+  (void)out;
+  return MCResResetConfiguration(resBuf);
+}
+
+static MOTCTRL_RES MCDispRefreshConfiguration(uint8_t * resBuf, MCResAny & out)
+{
+  (void)out;
+  return MCResRefreshConfiguration(resBuf);
+}
+
+static MOTCTRL_RES MCDispModifyConfiguration(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResModifyConfiguration(resBuf, out.u.conf.confType, out.u.conf.confID);
+}
+
+static MOTCTRL_RES MCDispRetrieveConfiguration(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResRetrieveConfiguration(resBuf, out.u.conf.confType, out.u.conf.confID, out.u.conf.confData);
+}
 
-  uint8_t indiDataPtr[4];
-  if (IsBigEndian()) {
-    indiDataPtr[0] = resBuf[7];
-    indiDataPtr[1] = resBuf[6];
-    indiDataPtr[2] = resBuf[5];
-    indiDataPtr[3] = resBuf[4];
+static MOTCTRL_RES MCDispStartMotor(uint8_t * resBuf, MCResAny & out)
+{
+  (void)out;
+  return MCResStartMotor(resBuf);
+}
+
+static MOTCTRL_RES MCDispStopMotor(uint8_t * resBuf, MCResAny & out)
+{
+  (void)out;
+  return MCResStopMotor(resBuf);
+}
+
+static MOTCTRL_RES MCDispTorqueControl(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResTorqueControl(resBuf, out.u.feedback.temp, out.u.feedback.position, out.u.feedback.speed, out.u.feedback.torque);
+}
+
+static MOTCTRL_RES MCDispSpeedControl(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResSpeedControl(resBuf, out.u.feedback.temp, out.u.feedback.position, out.u.feedback.speed, out.u.feedback.torque);
+}
+
+static MOTCTRL_RES MCDispPositionControl(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResPositionControl(resBuf, out.u.feedback.temp, out.u.feedback.position, out.u.feedback.speed, out.u.feedback.torque);
+}
+
+static MOTCTRL_RES MCDispPtsControl(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResPtsControl(resBuf, out.u.pts.ackSeq, out.u.pts.window);
+}
+
+static MOTCTRL_RES MCDispStopControl(uint8_t * resBuf, MCResAny & out)
+{
+  (void)out;
+  return MCResStopControl(resBuf);
+}
+
+static MOTCTRL_RES MCDispModifyParameter(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResModifyParameter(resBuf, out.u.para.paraID);
+}
+
+static MOTCTRL_RES MCDispRetrieveParameter(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResRetrieveParameter(resBuf, out.u.para.paraID, out.u.para.paraData);
+}
+
+static MOTCTRL_RES MCDispGetVersion(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResGetVersion(resBuf, out.u.version);
+}
+
+static MOTCTRL_RES MCDispGetFault(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResGetFault(resBuf, out.u.faultNo);
+}
+
+static MOTCTRL_RES MCDispAckFault(uint8_t * resBuf, MCResAny & out)
+{
+  (void)out;
+  return MCResAckFault(resBuf);
+}
+
+static MOTCTRL_RES MCDispRetrieveIndicator(uint8_t * resBuf, MCResAny & out)
+{
+  return MCResRetrieveIndicator(resBuf, out.u.indi.indiID, out.u.indi.indiData);
+}
+
+static MCResHandler s_resHandlers[MOTCTRL_CMD_SLOTS];
+static bool s_resHandlersReady = false;
+
+static void MCResHandlersInit()
+{
+  s_resHandlers[MOTCTRL_CMD_RESET_CONFIGURATION - MOTCTRL_CMD_FIRST] = MCDispResetConfiguration;
+  s_resHandlers[MOTCTRL_CMD_REFRESH_CONFIGURATION - MOTCTRL_CMD_FIRST] = MCDispRefreshConfiguration;
+  s_resHandlers[MOTCTRL_CMD_MODIFY_CONFIGURATION - MOTCTRL_CMD_FIRST] = MCDispModifyConfiguration;
+  s_resHandlers[MOTCTRL_CMD_RETRIEVE_CONFIGURATION - MOTCTRL_CMD_FIRST] = MCDispRetrieveConfiguration;
+  s_resHandlers[MOTCTRL_CMD_START_MOTOR - MOTCTRL_CMD_FIRST] = MCDispStartMotor;
+  s_resHandlers[MOTCTRL_CMD_STOP_MOTOR - MOTCTRL_CMD_FIRST] = MCDispStopMotor;
+  s_resHandlers[MOTCTRL_CMD_TORQUE_CONTROL - MOTCTRL_CMD_FIRST] = MCDispTorqueControl;
+  s_resHandlers[MOTCTRL_CMD_SPEED_CONTROL - MOTCTRL_CMD_FIRST] = MCDispSpeedControl;
+  s_resHandlers[MOTCTRL_CMD_POSITION_CONTROL - MOTCTRL_CMD_FIRST] = MCDispPositionControl;
+  s_resHandlers[MOTCTRL_CMD_PTS_CONTROL - MOTCTRL_CMD_FIRST] = MCDispPtsControl;
+  s_resHandlers[MOTCTRL_CMD_STOP_CONTROL - MOTCTRL_CMD_FIRST] = MCDispStopControl;
+  s_resHandlers[MOTCTRL_CMD_MODIFY_PARAMETER - MOTCTRL_CMD_FIRST] = MCDispModifyParameter;
+  s_resHandlers[MOTCTRL_CMD_RETRIEVE_PARAMETER - MOTCTRL_CMD_FIRST] = MCDispRetrieveParameter;
+  s_resHandlers[MOTCTRL_CMD_GET_VERSION - MOTCTRL_CMD_FIRST] = MCDispGetVersion;
+  s_resHandlers[MOTCTRL_CMD_GET_FAULT - MOTCTRL_CMD_FIRST] = MCDispGetFault;
+  s_resHandlers[MOTCTRL_CMD_ACK_FAULT - MOTCTRL_CMD_FIRST] = MCDispAckFault;
+  s_resHandlers[MOTCTRL_CMD_RETRIEVE_INDICATOR - MOTCTRL_CMD_FIRST] = MCDispRetrieveIndicator;
+  s_resHandlersReady = true;
+}
+
+MOTCTRL_RES MCResDispatch(uint8_t * resBuf, MCResAny & out)
+{
+  if (!s_resHandlersReady) {
+    MCResHandlersInit();
+  }
+  if (resBuf == 0 || resBuf[0] < MOTCTRL_CMD_FIRST || resBuf[0] > MOTCTRL_CMD_LAST) {
+    out.res = MOTCTRL_RES_FAIL_UNKNOWN_CMD;
+    return out.res;
   }
-  else {
-    indiDataPtr[0] = resBuf[4];
-    indiDataPtr[1] = resBuf[5];
-    indiDataPtr[2] = resBuf[6];
-    indiDataPtr[3] = resBuf[7];
+  MCResHandler handler = s_resHandlers[resBuf[0] - MOTCTRL_CMD_FIRST];
+  if (handler == 0) {
+    out.res = MOTCTRL_RES_FAIL_UNKNOWN_CMD;
+    return out.res;
   }
-  double * indiDataFloat = (double *)indiDataPtr;
-  indiData = *indiDataFloat;
-  return (MOTCTRL_RES)resBuf[2];
+  MOTCTRL_PERF_SCOPE_BEGIN();
+  out.cmd = (MOTCTRL_CMD)resBuf[0];
+  out.res = handler(resBuf, out);
+  MOTCTRL_PERF_SCOPE_END(&MCPerfDispatchStat);
+  return out.res;
 }
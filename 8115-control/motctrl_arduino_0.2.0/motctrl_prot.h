@@ -17,9 +17,86 @@
 #define _MOTCTRL_PROT_H__
 
 #include <stdint.h>
+#include <string.h>
 
 #define MOTCTRL_FRAME_SIZE 8
 
+/**
+ * Reciprocal multipliers for the feedback fields, folded at compile time so
+ * decoders pay one multiply-add per field instead of a runtime division.
+*/
+#define MOTCTRL_POS_SCALE    (25.0 / 65535)   // RAD per position LSB
+#define MOTCTRL_SPEED_SCALE  (130.0 / 4095)   // RAD/s per speed LSB
+#define MOTCTRL_TORQUE_SCALE (450.0 / 4095)   // Amper per torque LSB
+
+/**
+ * put on a frame block passed to the batch encoders to keep the block on
+ * its own cache line(s), e.g. uint8_t block[12 * MOTCTRL_FRAME_SIZE] MOTCTRL_FRAME_BLOCK_ALIGNED;
+*/
+#define MOTCTRL_FRAME_BLOCK_ALIGNED __attribute__((aligned(32)))
+
+/**
+ * read-only view over a raw frame still owned by the CAN driver; the typed
+ * accessors read in wire (little-endian) order, are safe for any buffer
+ * alignment, and make no staging copy, so decoding is usable straight from
+ * the RX buffer in interrupt context
+*/
+typedef struct {
+  const uint8_t * buf;
+
+  uint8_t U8(uint8_t offset) const
+  {
+    return buf[offset];
+  }
+  uint16_t U16(uint8_t offset) const
+  {
+    return (uint16_t)((uint16_t)buf[offset] | ((uint16_t)buf[offset + 1] << 8));
+  }
+  uint32_t U32(uint8_t offset) const
+  {
+    return (uint32_t)buf[offset] | ((uint32_t)buf[offset + 1] << 8) |
+           ((uint32_t)buf[offset + 2] << 16) | ((uint32_t)buf[offset + 3] << 24);
+  }
+  int32_t I32(uint8_t offset) const
+  {
+    return (int32_t)U32(offset);
+  }
+  float F32(uint8_t offset) const
+  {
+    uint32_t bits = U32(offset);
+    float val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+  }
+  bool Is(uint8_t cmd) const
+  {
+    return buf != 0 && buf[0] == cmd;
+  }
+} MCFrameView;
+
+/**
+ * command byte carried in byte 0 of every frame
+*/
+typedef enum {
+  MOTCTRL_CMD_RESET_CONFIGURATION = 0x81,
+  MOTCTRL_CMD_REFRESH_CONFIGURATION = 0x82,
+  MOTCTRL_CMD_MODIFY_CONFIGURATION = 0x83,
+  MOTCTRL_CMD_RETRIEVE_CONFIGURATION = 0x84,
+  MOTCTRL_CMD_START_MOTOR = 0x91,
+  MOTCTRL_CMD_STOP_MOTOR = 0x92,
+  MOTCTRL_CMD_TORQUE_CONTROL = 0x93,
+  MOTCTRL_CMD_SPEED_CONTROL = 0x94,
+  MOTCTRL_CMD_POSITION_CONTROL = 0x95,
+  MOTCTRL_CMD_PTS_CONTROL = 0x96,
+  MOTCTRL_CMD_STOP_CONTROL = 0x97,
+  MOTCTRL_CMD_MODIFY_PARAMETER = 0xA1,
+  MOTCTRL_CMD_RETRIEVE_PARAMETER = 0xA2,
+  MOTCTRL_CMD_GET_VERSION = 0xB1,
+  MOTCTRL_CMD_GET_FAULT = 0xB2,
+  MOTCTRL_CMD_ACK_FAULT = 0xB3,
+  MOTCTRL_CMD_RETRIEVE_INDICATOR = 0xB4,
+} MOTCTRL_CMD;
+
 /**
  * command execution result
 */
@@ -153,6 +230,8 @@ typedef enum {
   MOTCTRL_INDIID_OUTPUT_POWER = 0x15,
 } MOTCTRL_INDIID;
 
+#define MOTCTRL_INDIID_COUNT 22
+
 /**
  * @brief reset all configurations to default values
  * @param reqBuf command message buffer
@@ -289,6 +368,148 @@ void MCReqPositionControl(uint8_t * reqBuf, double position, uint32_t duration);
 */
 MOTCTRL_RES MCResPositionControl(uint8_t * resBuf, int8_t & temp, double & position, double & speed, double & torque);
 
+/**
+ * feedback sample in Q15 fixed point (32768 == 1.0), decoded without any
+ * floating-point arithmetic for targets without an FPU
+*/
+typedef struct {
+  int8_t temp;         // in Centigrade
+  int32_t position;    // in RAD for output shaft, Q15
+  int32_t speed;       // in RAD/s for output shaft, Q15
+  int32_t torque;      // in Amper, Q15, multiply by torque constant and gear ratio to get N.m
+} MCFeedbackQ15;
+
+/**
+ * @brief unpack the torque control response message, integer-only fast path
+ * @param resBuf response meesage buffer
+ * @param feedback decoded feedback sample in Q15
+ * @return result of the command execution
+*/
+MOTCTRL_RES MCResTorqueControlQ15(uint8_t * resBuf, MCFeedbackQ15 & feedback);
+
+/**
+ * @brief unpack the speed control response message, integer-only fast path
+ * @param resBuf response meesage buffer
+ * @param feedback decoded feedback sample in Q15
+ * @return result of the command execution
+*/
+MOTCTRL_RES MCResSpeedControlQ15(uint8_t * resBuf, MCFeedbackQ15 & feedback);
+
+/**
+ * @brief unpack the position control response message, integer-only fast path
+ * @param resBuf response meesage buffer
+ * @param feedback decoded feedback sample in Q15
+ * @return result of the command execution
+*/
+MOTCTRL_RES MCResPositionControlQ15(uint8_t * resBuf, MCFeedbackQ15 & feedback);
+
+/**
+ * one entry of a batched control command, one CAN frame per entry
+*/
+typedef struct {
+  uint32_t canID;      // CAN ID of the target motor, consumed by the TX layer, not packed into the frame
+  double setpoint;     // torque in N.m, speed in RPM or position in RAD depending on the batch call
+  uint32_t duration;   // in ms
+} MCBatchEntry;
+
+/**
+ * @brief encapsulate torque control command messages for several motors in one call
+ * @param frameBlock destination block of count * MOTCTRL_FRAME_SIZE bytes, frame i belongs to entries[i].canID
+ * @param entries per-motor setpoint entries
+ * @param count number of entries
+ * @return number of bytes written into frameBlock
+*/
+uint32_t MCReqTorqueControlBatch(uint8_t * frameBlock, const MCBatchEntry * entries, uint32_t count);
+
+/**
+ * @brief encapsulate speed control command messages for several motors in one call
+ * @param frameBlock destination block of count * MOTCTRL_FRAME_SIZE bytes, frame i belongs to entries[i].canID
+ * @param entries per-motor setpoint entries
+ * @param count number of entries
+ * @return number of bytes written into frameBlock
+*/
+uint32_t MCReqSpeedControlBatch(uint8_t * frameBlock, const MCBatchEntry * entries, uint32_t count);
+
+/**
+ * @brief encapsulate position control command messages for several motors in one call
+ * @param frameBlock destination block of count * MOTCTRL_FRAME_SIZE bytes, frame i belongs to entries[i].canID
+ * @param entries per-motor setpoint entries
+ * @param count number of entries
+ * @return number of bytes written into frameBlock
+*/
+uint32_t MCReqPositionControlBatch(uint8_t * frameBlock, const MCBatchEntry * entries, uint32_t count);
+
+/**
+ * @brief encapsulate one position-time-series control knot message
+ * @param reqBuf command message buffer
+ * @param seqNo running sequence number of the knot
+ * @param position knot position in RAD
+ * @param time time from the previous knot in ms, interpolated locally by the motor
+*/
+void MCReqPtsControl(uint8_t * reqBuf, uint8_t seqNo, double position, uint16_t time);
+/**
+ * @brief unpack the position-time-series control response message
+ * @param resBuf response meesage buffer
+ * @param ackSeq sequence number of the last knot consumed by the motor
+ * @param window number of free knot slots in the motor-side buffer
+ * @return result of the command execution
+*/
+MOTCTRL_RES MCResPtsControl(uint8_t * resBuf, uint8_t & ackSeq, uint8_t & window);
+
+#define MOTCTRL_PTS_BUFFER_KNOTS 32
+
+/**
+ * one knot of a position-time-series trajectory
+*/
+typedef struct {
+  double position;     // in RAD
+  uint16_t time;       // in ms from the previous knot
+} MCPtsKnot;
+
+/**
+ * host-side trajectory stream with windowed acknowledgment; knots are queued
+ * with MCPtsStreamPush, packed into frames by MCPtsStreamPump as the motor
+ * grants window, and credits are returned through MCPtsStreamOnAck
+*/
+typedef struct {
+  MCPtsKnot knots[MOTCTRL_PTS_BUFFER_KNOTS];
+  uint8_t head;        // index of the oldest queued knot
+  uint8_t count;       // number of queued knots
+  uint8_t nextSeq;     // sequence number of the next knot to transmit
+  uint8_t ackSeq;      // last sequence number acknowledged by the motor
+  uint8_t window;      // motor-side buffer slots currently granted
+} MCPtsStream;
+
+/**
+ * @brief initialize a trajectory stream
+ * @param stream the stream to initialize
+ * @param window initial motor-side window before the first acknowledgment
+*/
+void MCPtsStreamInit(MCPtsStream & stream, uint8_t window);
+/**
+ * @brief queue a trajectory knot
+ * @param stream the trajectory stream
+ * @param position knot position in RAD
+ * @param time time from the previous knot in ms
+ * @return true if the knot was queued, false if the host-side buffer is full
+*/
+bool MCPtsStreamPush(MCPtsStream & stream, double position, uint16_t time);
+/**
+ * @brief pack as many queued knots as the current window allows into consecutive frames
+ * @param stream the trajectory stream
+ * @param frameBlock destination block of at least maxFrames * MOTCTRL_FRAME_SIZE bytes
+ * @param maxFrames capacity of frameBlock in frames
+ * @return number of frames packed
+*/
+uint32_t MCPtsStreamPump(MCPtsStream & stream, uint8_t * frameBlock, uint32_t maxFrames);
+/**
+ * @brief feed an acknowledgment decoded by MCResPtsControl back into the stream
+ * @param stream the trajectory stream
+ * @param ackSeq acknowledged sequence number from the response
+ * @param window granted window from the response
+*/
+void MCPtsStreamOnAck(MCPtsStream & stream, uint8_t ackSeq, uint8_t window);
+
 /**
  * @brief stop current control process
  * @param reqBuf command message buffer
@@ -384,4 +605,91 @@ void MCReqRetrieveIndicator(uint8_t * reqBuf, MOTCTRL_INDIID indiID);
 */
 MOTCTRL_RES MCResRetrieveIndicator(uint8_t * resBuf, MOTCTRL_INDIID & indiID, double & indiData);
 
+/**
+ * up to 6 indicator ids fit in the payload of one bulk request frame
+*/
+#define MOTCTRL_INDICATOR_BULK_MAX 6
+
+/**
+ * accumulator for a bulk indicator response burst, one value slot per
+ * MOTCTRL_INDIID; complete when pendingMask drops to zero
+*/
+typedef struct {
+  double values[MOTCTRL_INDIID_COUNT];
+  uint32_t validMask;      // bit i set when values[i] has been received
+  uint32_t pendingMask;    // bits of requested ids not yet received
+} MCIndicatorSnapshot;
+
+/**
+ * @brief retrieve a set of runtime indicators with a single request
+ * @param reqBuf command message buffer
+ * @param indiIDs indicator ids to retrieve, at most MOTCTRL_INDICATOR_BULK_MAX
+ * @param count number of ids in indiIDs
+*/
+void MCReqRetrieveIndicatorBulk(uint8_t * reqBuf, const MOTCTRL_INDIID * indiIDs, uint8_t count);
+/**
+ * @brief prepare a snapshot accumulator for the ids named in a bulk request
+ * @param snapshot the accumulator to initialize
+ * @param indiIDs indicator ids that were requested
+ * @param count number of ids in indiIDs
+*/
+void MCIndicatorSnapshotInit(MCIndicatorSnapshot & snapshot, const MOTCTRL_INDIID * indiIDs, uint8_t count);
+/**
+ * @brief feed one frame of the bulk response burst into the snapshot
+ * @param resBuf response meesage buffer, same layout as the single indicator response
+ * @param snapshot the accumulator to fill
+ * @return result of the command execution
+*/
+MOTCTRL_RES MCResRetrieveIndicatorBulk(uint8_t * resBuf, MCIndicatorSnapshot & snapshot);
+/**
+ * @brief check whether every requested indicator has been received
+ * @param snapshot the accumulator to check
+ * @return true when the burst is complete
+*/
+bool MCIndicatorSnapshotComplete(const MCIndicatorSnapshot & snapshot);
+
+/**
+ * decoded response of any command, tagged by cmd; which union member is
+ * valid follows from the tag
+*/
+typedef struct {
+  MOTCTRL_CMD cmd;                 // command the frame answers
+  MOTCTRL_RES res;                 // result of the command execution
+  union {
+    struct {
+      MOTCTRL_CONFTYPE confType;
+      MOTCTRL_CONFID confID;
+      double confData;             // valid for MOTCTRL_CMD_RETRIEVE_CONFIGURATION only
+    } conf;                        // modify / retrieve configuration
+    struct {
+      MOTCTRL_PARAID paraID;
+      double paraData;             // valid for MOTCTRL_CMD_RETRIEVE_PARAMETER only
+    } para;                        // modify / retrieve parameter
+    struct {
+      int8_t temp;
+      double position;
+      double speed;
+      double torque;
+    } feedback;                    // torque / speed / position control
+    struct {
+      uint8_t ackSeq;
+      uint8_t window;
+    } pts;                         // position-time-series control
+    uint32_t version;              // get version
+    MOTCTRL_FAULTNO faultNo;       // get fault
+    struct {
+      MOTCTRL_INDIID indiID;
+      double indiData;
+    } indi;                        // retrieve indicator
+  } u;
+} MCResAny;
+
+/**
+ * @brief route a received frame to its unpacker through a command-indexed table
+ * @param resBuf response meesage buffer
+ * @param out tagged decode result
+ * @return result of the command execution, MOTCTRL_RES_FAIL_UNKNOWN_CMD for an unroutable frame
+*/
+MOTCTRL_RES MCResDispatch(uint8_t * resBuf, MCResAny & out);
+
 #endif
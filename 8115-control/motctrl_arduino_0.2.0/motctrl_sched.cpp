@@ -0,0 +1,93 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_sched.cpp
+  * @author  LYH, CyberBeast
+  * @brief   This file provides a bus cycle scheduler for several CyberBeast
+  *          motors sharing one CAN bus
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#include "motctrl_sched.h"
+
+void MCSchedInit(MCBusSchedule & schedule, uint32_t periodUs)
+{
+  schedule.count = 0;
+  schedule.periodUs = periodUs;
+  schedule.slotUs = periodUs;
+  schedule.cycleStartUs = 0;
+  schedule.cursor = 0;
+}
+
+bool MCSchedAddMotor(MCBusSchedule & schedule, uint32_t canID)
+{
+  if (schedule.count >= MOTCTRL_SCHED_MAX_MOTORS) {
+    return false;
+  }
+  MCSchedSlot & slot = schedule.slots[schedule.count];
+  slot.canID = canID;
+  slot.deadlineMisses = 0;
+  slot.pending = false;
+  schedule.count++;
+
+  // Redistribute the period evenly over all motors
+  schedule.slotUs = schedule.periodUs / schedule.count;
+  for (uint8_t i = 0; i < schedule.count; i++) {
+    schedule.slots[i].txOffset = (uint32_t)i * schedule.slotUs;
+  }
+  return true;
+}
+
+int MCSchedNextSlot(MCBusSchedule & schedule, uint32_t nowUs)
+{
+  if (schedule.count == 0) {
+    return -1;
+  }
+
+  uint32_t elapsed = nowUs - schedule.cycleStartUs;
+  if (elapsed >= schedule.periodUs) {
+    // Cycle rollover: any slot still pending missed its response deadline
+    for (uint8_t i = 0; i < schedule.count; i++) {
+      if (schedule.slots[i].pending) {
+        schedule.slots[i].deadlineMisses++;
+        schedule.slots[i].pending = false;
+      }
+    }
+    schedule.cycleStartUs += (elapsed / schedule.periodUs) * schedule.periodUs;
+    schedule.cursor = 0;
+    elapsed = nowUs - schedule.cycleStartUs;
+  }
+
+  if (schedule.cursor < schedule.count && elapsed >= schedule.slots[schedule.cursor].txOffset) {
+    int due = schedule.cursor;
+    schedule.slots[due].pending = true;
+    schedule.cursor++;
+    return due;
+  }
+  return -1;
+}
+
+void MCSchedOnResponse(MCBusSchedule & schedule, uint32_t canID)
+{
+  for (uint8_t i = 0; i < schedule.count; i++) {
+    if (schedule.slots[i].canID == canID) {
+      schedule.slots[i].pending = false;
+      return;
+    }
+  }
+}
+
+uint32_t MCSchedDeadlineMisses(const MCBusSchedule & schedule)
+{
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < schedule.count; i++) {
+    total += schedule.slots[i].deadlineMisses;
+  }
+  return total;
+}
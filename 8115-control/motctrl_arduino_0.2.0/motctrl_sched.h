@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * @file    motctrl_sched.h
+  * @author  LYH, CyberBeast
+  * @brief   This file provides a bus cycle scheduler for several CyberBeast
+  *          motors sharing one CAN bus
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2022 CyberBeast.
+  * All rights reserved.</center></h2>
+  *
+  ******************************************************************************
+  *
+  */
+#ifndef _MOTCTRL_SCHED_H__
+#define _MOTCTRL_SCHED_H__
+
+#include <stdint.h>
+
+#define MOTCTRL_SCHED_MAX_MOTORS 16
+
+/**
+ * one TX slot of the cycle table: the motor's command frame is sent at
+ * txOffset within the control period and its response is expected before
+ * the next slot opens
+*/
+typedef struct {
+  uint32_t canID;           // CAN ID of the motor owning the slot
+  uint32_t txOffset;        // slot start offset within the period, in us
+  uint32_t deadlineMisses;  // cycles where the response missed the slot
+  bool pending;             // command sent, response still outstanding
+} MCSchedSlot;
+
+/**
+ * cycle table assigning each motor a time slice of the control period, so
+ * command frames are spread over the period instead of bursting back to
+ * back and starving the RX path
+*/
+typedef struct {
+  MCSchedSlot slots[MOTCTRL_SCHED_MAX_MOTORS];
+  uint8_t count;            // number of motors in the table
+  uint32_t periodUs;        // control period, in us
+  uint32_t slotUs;          // periodUs / count, recomputed on add
+  uint32_t cycleStartUs;    // timestamp of the running cycle's start
+  uint8_t cursor;           // next slot to transmit in the running cycle
+} MCBusSchedule;
+
+/**
+ * @brief initialize an empty cycle table
+ * @param schedule the table to initialize
+ * @param periodUs control period in us (1000 for a 1 kHz loop)
+*/
+void MCSchedInit(MCBusSchedule & schedule, uint32_t periodUs);
+/**
+ * @brief append a motor and redistribute the TX slots evenly
+ * @param schedule the cycle table
+ * @param canID CAN ID of the motor
+ * @return true if the motor was added, false if the table is full
+*/
+bool MCSchedAddMotor(MCBusSchedule & schedule, uint32_t canID);
+/**
+ * @brief advance the schedule; rolls the cycle over and books deadline
+ *        misses for slots whose response never arrived
+ * @param schedule the cycle table
+ * @param nowUs current monotonic time in us
+ * @return index of the slot whose TX time has arrived, -1 if none is due
+*/
+int MCSchedNextSlot(MCBusSchedule & schedule, uint32_t nowUs);
+/**
+ * @brief mark a motor's response as received for the running cycle
+ * @param schedule the cycle table
+ * @param canID CAN ID the response came from
+*/
+void MCSchedOnResponse(MCBusSchedule & schedule, uint32_t canID);
+/**
+ * @brief total deadline misses across all slots
+ * @param schedule the cycle table
+ * @return accumulated miss count
+*/
+uint32_t MCSchedDeadlineMisses(const MCBusSchedule & schedule);
+
+#endif
@@ -17,10 +17,16 @@
 
 #include <Arduino.h>
 #include "driver/twai.h"
+#include "driver/adc.h"
 #include "esp_task_wdt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <motctrl_perf.h>
 
 // CAN Configuration
 #define CAN_ID_SAFETY       0x005
+#define CAN_ID_SAFETY_CMD   0x006   // host -> safety node commands
+#define CAN_ID_TELEMETRY    0x007   // safety node -> host hall trend telemetry
 #define DEVICE_ID_1         0x01
 #define DEVICE_ID_2         0x02
 #define STATUS_MIN_LIMIT    0x10
@@ -28,6 +34,24 @@
 #define STATUS_LIMIT1_FIND  0x11
 #define STATUS_LIMIT2_FIND  0x12
 
+// Telemetry frame types (second payload byte on CAN_ID_TELEMETRY)
+#define TELEMETRY_FULL      0x01  // [device_id, type, adc_lo, adc_hi] 12-bit absolute
+#define TELEMETRY_DELTA     0x02  // [device_id, type, delta_int8] relative to last frame
+
+// Host command codes (first payload byte on CAN_ID_SAFETY_CMD)
+#define HOSTCMD_ARM             0x01  // [cmd]
+#define HOSTCMD_DISARM          0x02  // [cmd]
+#define HOSTCMD_SET_HEARTBEAT   0x03  // [cmd, interval_s]
+#define HOSTCMD_SET_THRESHOLD   0x04  // [cmd, threshold_idx, value_lo, value_hi]
+#define HOSTCMD_DUMP_PERF       0x05  // [cmd] dump cycle statistics to Serial
+#define HOSTCMD_SET_TELEMETRY   0x06  // [cmd, enable, deadband, resync_n] (last two optional)
+
+// Threshold indices for HOSTCMD_SET_THRESHOLD
+#define THRESHOLD_IDX_RED_ON       0
+#define THRESHOLD_IDX_RED_BLINK    1
+#define THRESHOLD_IDX_GREEN_BLINK  2
+#define THRESHOLD_IDX_GREEN_ON     3
+
 // CAN Bitrate configuration (set via build flags)
 // Options: 250, 500, 800, 1000 kbps
 #ifndef CAN_SPEED_KBPS
@@ -71,35 +95,104 @@
 // LED blink interval
 #define LED_BLINK_INTERVAL   500  // 500ms blink period
 
+// Differential hall telemetry: the filtered ADC value is checked at
+// TELEMETRY_CHECK_MS; a compact delta frame goes out only when it moved at
+// least the deadband since the last frame, with a full absolute value every
+// TELEMETRY_RESYNC_N deltas so a lost frame cannot skew the trend for long
+#define TELEMETRY_CHECK_MS   100  // check period, also the max per-device rate
+#define TELEMETRY_DEADBAND   8    // minimum movement in ADC counts for a delta
+#define TELEMETRY_RESYNC_N   32   // full-value resync after this many deltas
+
 // Debug output (set to 0 to disable)
 #define ENABLE_DEBUG_OUTPUT  1
 
-// Device configuration (set via build flags)
-#ifndef DEVICE_ID
-#define DEVICE_ID           DEVICE_ID_1  // Default to Device 1
-#endif
-
 // Pin Configuration (ESP32-S2)
 #define CAN_TX_PIN          5   // GPIO 5
 #define CAN_RX_PIN          4   // GPIO 4
-#define HALL_SENSOR_PIN     1   // GPIO 1 (A0, ADC)
+#define HALL_SENSOR_PIN     1   // GPIO 1 (A0, ADC), device 1
+#define HALL_SENSOR2_PIN    2   // GPIO 2 (ADC), device 2
 #define LED_GREEN_PIN       39  // GPIO 39 (Green LED)
 #define LED_RED_PIN         40  // GPIO 40 (Red LED)
 
+// Number of safety devices monitored by this board (one hall channel each).
+// The board has two wired hall channels, so 1 or 2.
+#ifndef SAFETY_DEVICE_COUNT
+#define SAFETY_DEVICE_COUNT 2
+#endif
+#if SAFETY_DEVICE_COUNT < 1 || SAFETY_DEVICE_COUNT > 2
+#error "SAFETY_DEVICE_COUNT must be 1 or 2 (two hall channels are wired)"
+#endif
+
+#define HALL_FILTER_WINDOW   16  // moving-average length, power of two
+
+// Zone of a hall value, ordered for the limit ladder
+enum HallZone {
+  ZONE_RED_ON = 0,      // below red-on threshold, min limit
+  ZONE_RED_BLINK,       // approaching min limit
+  ZONE_NORMAL,
+  ZONE_GREEN_BLINK,     // approaching max limit
+  ZONE_GREEN_ON,        // above green-on threshold, max limit
+};
+
+// Per-device state: thresholds, limit flags, filter and watermarks. One
+// instance per monitored axis, replacing the former single-device globals.
+typedef struct {
+  uint8_t device_id;          // ID reported in CAN payloads
+  uint8_t hall_pin;           // analogRead fallback pin
+  uint8_t adc_channel;        // ADC1 channel for the DMA demux
+
+  // Host-adjustable thresholds (HOSTCMD_SET_THRESHOLD)
+  int red_on_threshold;
+  int red_blink_threshold;
+  int green_blink_threshold;
+  int green_on_threshold;
+
+  // Limit state machine
+  int last_hall_value;
+  bool limit1_find_sent;
+  bool limit2_find_sent;
+
+  // Moving-average filter (sampler task context)
+  uint16_t window[HALL_FILTER_WINDOW];
+  uint8_t window_pos;
+  uint32_t window_sum;
+  int prev_avg;
+  volatile int filtered_value;
+  volatile int slope;         // change per drained buffer, in ADC counts
+
+  // Event-driven watermarks (see hallArmWatermarks)
+  volatile int wm_low;
+  volatile int wm_high;
+  volatile bool zone_event;
+
+  // Differential telemetry (see pumpTelemetry)
+  int tele_last;              // last value reported on CAN_ID_TELEMETRY
+  uint8_t tele_deltas;        // delta frames since the last full frame
+  bool tele_synced;           // a full frame has been sent, tele_last is valid
+} SafetyDevice;
+
+SafetyDevice devices[SAFETY_DEVICE_COUNT];
+
 // State variables
-uint8_t current_device_id = DEVICE_ID;
-unsigned long last_heartbeat = 0;
 unsigned long last_hall_read = 0;
 unsigned long last_led_update = 0;
 
-// Hall sensor state
-int last_hall_value = 0;
+// Host-adjustable state (updated from CAN commands, see processRxFrames)
+bool node_armed = true;
+unsigned long heartbeat_interval = HEARTBEAT_INTERVAL;
+uint8_t hb_stretch = 1;               // bus-load governor multiplier, 1 = bus healthy
+bool telemetry_enabled = true;
+uint8_t telemetry_deadband = TELEMETRY_DEADBAND;
+uint8_t telemetry_resync_n = TELEMETRY_RESYNC_N;
+uint32_t tele_full_sent = 0;
+uint32_t tele_delta_sent = 0;
+uint32_t tele_suppressed = 0;         // checks inside the deadband, no frame
+
+// LED state (one LED pair shows the most critical zone across devices)
 bool red_led_state = false;
 bool green_led_state = false;
 bool red_blink_mode = false;
 bool green_blink_mode = false;
-bool limit1_find_sent = false;  // Track if Limit1 Find was sent
-bool limit2_find_sent = false;  // Track if Limit2 Find was sent
 
 // CAN error state
 bool can_error_mode = false;
@@ -110,10 +203,185 @@ bool can_error_led_toggle = false;
 // TWAI message structure
 twai_message_t tx_message;
 
+// ============================================================
+// Binary trace ring
+// ============================================================
+// Hot paths record fixed-size binary events with a timestamp and payload
+// into a preallocated ring (a few memcpys, no formatting, no UART wait).
+// The ring is drained opportunistically from loop() in a low-priority slot;
+// ENABLE_DEBUG_OUTPUT selects whether drained records are formatted to
+// Serial, not whether recording costs anything.
+
+#define TRACE_RING_SIZE      64  // records, power of two
+#define TRACE_DRAIN_PER_LOOP 2   // records formatted per loop pass
+
+// Trace event types
+#define TRACE_EV_CAN_TX        1  // payload: frame data, can_id set
+#define TRACE_EV_CAN_TX_FAIL   2  // payload[0]: esp_err_t low byte
+#define TRACE_EV_CAN_RESTORED  3
+#define TRACE_EV_CAN_ERRMODE   4
+#define TRACE_EV_HALL          5  // payload[0]: status code or 0, payload[1..2]: ADC value LE
+#define TRACE_EV_HOST_CMD      6  // payload: command frame data
+
+typedef struct {
+  uint32_t timestamp_ms;
+  uint16_t can_id;
+  uint8_t event;
+  uint8_t len;
+  uint8_t payload[8];
+} TraceRecord;  // 16 bytes
+
+TraceRecord trace_ring[TRACE_RING_SIZE];
+volatile uint16_t trace_head = 0;  // written by recorders
+volatile uint16_t trace_tail = 0;  // written by the drain
+uint32_t trace_dropped = 0;
+
 /**
- * Initialize TWAI (CAN) bus
+ * Record a trace event (cheap enough for any hot path)
  */
-void setupTWAI() {
+void traceEvent(uint8_t event, uint16_t can_id, const uint8_t* payload, uint8_t len) {
+  uint16_t head = trace_head;
+  uint16_t next = (head + 1) & (TRACE_RING_SIZE - 1);
+  if (next == trace_tail) {
+    trace_dropped++;  // tracing never blocks; old records win
+    return;
+  }
+  TraceRecord* rec = &trace_ring[head];
+  rec->timestamp_ms = millis();
+  rec->can_id = can_id;
+  rec->event = event;
+  rec->len = len > 8 ? 8 : len;
+  for (uint8_t i = 0; i < rec->len; i++) {
+    rec->payload[i] = payload[i];
+  }
+  trace_head = next;
+}
+
+/**
+ * Format and print drained records (low-priority slot in loop())
+ */
+void drainTraceRing() {
+#if ENABLE_DEBUG_OUTPUT
+  for (int n = 0; n < TRACE_DRAIN_PER_LOOP && trace_tail != trace_head; n++) {
+    TraceRecord* rec = &trace_ring[trace_tail];
+    switch (rec->event) {
+      case TRACE_EV_CAN_TX:
+        Serial.printf("[%lu] Sent: CAN ID 0x%03X [", rec->timestamp_ms, rec->can_id);
+        for (uint8_t i = 0; i < rec->len; i++) {
+          Serial.printf("0x%02X", rec->payload[i]);
+          if (i < rec->len - 1) Serial.print(" ");
+        }
+        Serial.println("]");
+        break;
+      case TRACE_EV_CAN_TX_FAIL:
+        Serial.printf("[%lu] CAN TX failed, err 0x%02X\n", rec->timestamp_ms, rec->payload[0]);
+        break;
+      case TRACE_EV_CAN_RESTORED:
+        Serial.printf("[%lu] CAN communication restored\n", rec->timestamp_ms);
+        break;
+      case TRACE_EV_CAN_ERRMODE:
+        Serial.printf("[%lu] CAN ERROR MODE: 3+ consecutive failures\n", rec->timestamp_ms);
+        break;
+      case TRACE_EV_HALL: {
+        int value = (int)rec->payload[1] | ((int)rec->payload[2] << 8);
+        const SafetyDevice* dev = &devices[rec->can_id < SAFETY_DEVICE_COUNT ? rec->can_id : 0];
+        Serial.printf("[%lu] [D%u ADC: %4d] ", rec->timestamp_ms, dev->device_id, value);
+        if (value < dev->red_on_threshold) {
+          Serial.print("RED_ON (Min Limit) ");
+        } else if (value < dev->red_blink_threshold) {
+          Serial.print("RED_BLINK (Approaching Min) ");
+        } else if (value > dev->green_on_threshold) {
+          Serial.print("GREEN_ON (Max Limit) ");
+        } else if (value > dev->green_blink_threshold) {
+          Serial.print("GREEN_BLINK (Approaching Max) ");
+        } else {
+          Serial.print("NORMAL ");
+        }
+        if (rec->payload[0] != 0) {
+          Serial.printf(">>> EVENT: status 0x%02X", rec->payload[0]);
+        }
+        Serial.println();
+        break;
+      }
+      case TRACE_EV_HOST_CMD:
+        Serial.printf("[%lu] Host command 0x%02X\n", rec->timestamp_ms, rec->payload[0]);
+        break;
+      default:
+        break;
+    }
+    trace_tail = (trace_tail + 1) & (TRACE_RING_SIZE - 1);
+  }
+#else
+  trace_tail = trace_head;  // no sink configured, discard drained records
+#endif
+}
+
+// ============================================================
+// Lock-free RX path
+// ============================================================
+// A dedicated high-priority task blocks in twai_receive() and pushes frames
+// into a single-producer single-consumer ring buffer that loop() drains.
+// Head is written only by the producer, tail only by the consumer, so no
+// lock is needed and RX never blocks checkHallSensor() or Serial output.
+
+#define RX_RING_SIZE  16  // must be a power of two
+
+typedef struct {
+  twai_message_t frames[RX_RING_SIZE];
+  volatile uint16_t head;  // written by RX task only
+  volatile uint16_t tail;  // written by loop() only
+} RxRing;
+
+RxRing rx_ring = {};
+volatile uint32_t rx_ring_overruns = 0;  // frames dropped because the ring was full
+
+/**
+ * Push a frame into the RX ring (producer side, RX task context)
+ */
+bool rxRingPush(const twai_message_t* msg) {
+  uint16_t head = rx_ring.head;
+  uint16_t next = (head + 1) & (RX_RING_SIZE - 1);
+  if (next == rx_ring.tail) {
+    return false;  // ring full, frame dropped
+  }
+  rx_ring.frames[head] = *msg;
+  rx_ring.head = next;  // publish after the copy
+  return true;
+}
+
+/**
+ * Pop a frame from the RX ring (consumer side, loop() context)
+ */
+bool rxRingPop(twai_message_t* msg) {
+  uint16_t tail = rx_ring.tail;
+  if (tail == rx_ring.head) {
+    return false;  // ring empty
+  }
+  *msg = rx_ring.frames[tail];
+  rx_ring.tail = (tail + 1) & (RX_RING_SIZE - 1);
+  return true;
+}
+
+/**
+ * RX task: feed the ring from the TWAI driver
+ * (the TWAI ISR fills the driver queue; this task only moves frames across)
+ */
+void rxTask(void* arg) {
+  twai_message_t msg;
+  for (;;) {
+    if (twai_receive(&msg, portMAX_DELAY) == ESP_OK) {
+      if (!rxRingPush(&msg)) {
+        rx_ring_overruns++;
+      }
+    }
+  }
+}
+
+/**
+ * Initialize TWAI (CAN) bus; returns false instead of blocking so boot can
+ * proceed and the bring-up can be retried in the background
+ */
+bool setupTWAI() {
   // Configure TWAI pins
   twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(
     (gpio_num_t)CAN_TX_PIN,
@@ -124,100 +392,435 @@ void setupTWAI() {
   // Configure timing (500 kbps)
   twai_timing_config_t t_config = CAN_BITRATE;
   
-  // Configure filter to accept all messages (we only send, but need filter for init)
-  twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+  // Hardware acceptance filter: the node only listens for host commands on
+  // CAN_ID_SAFETY_CMD, so let the controller drop everything else instead of
+  // taking an RX interrupt for every motor frame on the bus.
+  twai_filter_config_t f_config;
+  f_config.acceptance_code = (uint32_t)CAN_ID_SAFETY_CMD << 21;
+  f_config.acceptance_mask = ~((uint32_t)TWAI_STD_ID_MASK << 21);
+  f_config.single_filter = true;
   
   // Install TWAI driver
   esp_err_t result = twai_driver_install(&g_config, &t_config, &f_config);
   if (result != ESP_OK) {
-    Serial.printf("Failed to install TWAI driver: %s\n", esp_err_to_name(result));
-    while (1) {
-      delay(1000);
-    }
+    return false;
   }
-  
+
   // Start TWAI driver (note: in some ESP32 versions, this is done automatically)
   result = twai_start();
   if (result != ESP_OK) {
-    Serial.printf("Failed to start TWAI driver: %s\n", esp_err_to_name(result));
-    while (1) {
-      delay(1000);
-    }
+    twai_driver_uninstall();
+    return false;
+  }
+  return true;
+}
+
+// Background CAN bring-up: hall monitoring must not wait for the bus, so
+// setup() only attempts this once and a low-rate scheduler task keeps
+// retrying on failure. Limit events detected before the bus is up stay
+// buffered in the TX queue (pumpTxQueue holds off until twai_started).
+#define TWAI_RETRY_MS  250
+
+bool twai_started = false;
+uint32_t twai_retries = 0;
+
+void bringUpCAN() {
+  if (twai_started) {
+    return;
+  }
+  if (setupTWAI()) {
+    twai_started = true;
+    // Start the RX task feeding the lock-free ring only now that
+    // twai_receive can block instead of spinning on a missing driver
+    // (priority above loopTask so a burst of frames never backs up)
+    xTaskCreate(rxTask, "can_rx", 2048, NULL, configMAX_PRIORITIES - 2, NULL);
+    Serial.printf("TWAI (CAN) bus up after %lu retries\n", (unsigned long)twai_retries);
+  } else {
+    twai_retries++;
   }
-  
-  Serial.println("TWAI (CAN) bus initialized successfully");
 }
 
 /**
- * Check and recover from Bus-Off state
+ * Check and recover from Bus-Off state (non-blocking)
  */
 void checkBusRecovery() {
   twai_status_info_t status_info;
   twai_get_status_info(&status_info);
-  
+
   if (status_info.state == TWAI_STATE_BUS_OFF) {
     Serial.println("CAN Bus-Off detected, attempting recovery...");
     twai_initiate_recovery();
-    delay(100);  // Wait for recovery
+    // Recovery completes in the background; pumpTxQueue keeps retrying
   }
 }
 
+// ============================================================
+// Non-blocking TX queue
+// ============================================================
+// Outgoing messages are queued with a priority (limit-switch events preempt
+// heartbeats) and transmitted with zero-timeout twai_transmit attempts from
+// loop(). A congested bus therefore never stalls checkHallSensor(): worst
+// case hall-to-CAN latency is one loop iteration. Heartbeats are coalesced
+// (a newer one overwrites a queued stale one) and dropped if they sit in
+// the queue longer than TX_STALE_MS; limit events are retried until sent.
+
+#define TX_QUEUE_SIZE      8
+#define TX_PRIO_LIMIT      0    // limit-switch events, highest priority
+#define TX_PRIO_HEARTBEAT  1
+#define TX_PRIO_TELEMETRY  2    // evicted first when the queue fills
+#define TX_STALE_MS        500  // age at which a queued heartbeat is dropped
+
+typedef struct {
+  bool used;
+  uint8_t prio;            // lower value = higher priority
+  uint8_t len;
+  uint32_t id;
+  uint32_t order;          // enqueue sequence, keeps FIFO order within a priority
+  unsigned long enqueued;  // millis() at enqueue, for stale-drop
+  uint8_t data[8];
+} TxEntry;
+
+TxEntry tx_queue[TX_QUEUE_SIZE];
+uint32_t tx_order_seq = 0;
+uint32_t tx_dropped = 0;  // messages dropped (queue full or stale)
+
+// Cycle statistics around twai_transmit (see motctrl_perf.h)
+MCPerfStat perf_tx_stat;
+
+void dumpSchedStats();  // defined with the scheduler below
+
 /**
- * Send CAN message via TWAI
+ * Dump cycle statistics on demand (HOSTCMD_DUMP_PERF)
  */
-bool sendCANMessage(uint32_t can_id, uint8_t* data, uint8_t data_len) {
-  // Check bus state and recover if needed
+void dumpPerfStats() {
+  Serial.printf("twai_transmit cycles: n=%lu min=%lu max=%lu avg=%lu p99=%lu\n",
+                (unsigned long)perf_tx_stat.count,
+                (unsigned long)perf_tx_stat.min,
+                (unsigned long)perf_tx_stat.max,
+                (unsigned long)(perf_tx_stat.count ? perf_tx_stat.sum / perf_tx_stat.count : 0),
+                (unsigned long)MCPerfPercentile(&perf_tx_stat, 99));
+  Serial.printf("tx_dropped=%lu trace_dropped=%lu rx_overruns=%lu hb_stretch=%u\n",
+                (unsigned long)tx_dropped,
+                (unsigned long)trace_dropped,
+                (unsigned long)rx_ring_overruns,
+                (unsigned)hb_stretch);
+  Serial.printf("tele_full=%lu tele_delta=%lu tele_suppressed=%lu\n",
+                (unsigned long)tele_full_sent,
+                (unsigned long)tele_delta_sent,
+                (unsigned long)tele_suppressed);
+  dumpSchedStats();
+}
+
+/**
+ * Queue a CAN message for transmission
+ * coalesce: overwrite an already-queued message with the same ID/priority
+ */
+bool enqueueCANMessage(uint32_t can_id, uint8_t* data, uint8_t data_len, uint8_t prio, bool coalesce) {
+  int slot = -1;
+
+  if (coalesce) {
+    for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+      if (tx_queue[i].used && tx_queue[i].id == can_id && tx_queue[i].prio == prio) {
+        slot = i;  // replace the stale copy
+        break;
+      }
+    }
+  }
+  if (slot < 0) {
+    for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+      if (!tx_queue[i].used) {
+        slot = i;
+        break;
+      }
+    }
+  }
+  if (slot < 0) {
+    // Queue full: evict a heartbeat to make room for a higher-priority message
+    for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+      if (tx_queue[i].prio > prio) {
+        slot = i;
+        tx_dropped++;
+        break;
+      }
+    }
+  }
+  if (slot < 0) {
+    tx_dropped++;
+    return false;
+  }
+
+  TxEntry* e = &tx_queue[slot];
+  e->used = true;
+  e->prio = prio;
+  e->len = data_len;
+  e->id = can_id;
+  e->order = tx_order_seq++;
+  e->enqueued = millis();
+  for (int i = 0; i < data_len && i < 8; i++) {
+    e->data[i] = data[i];
+  }
+  return true;
+}
+
+/**
+ * Attempt one zero-timeout transmit of the best queued message (loop() context)
+ */
+void pumpTxQueue() {
+  if (!twai_started) {
+    return;  // bus still coming up, keep events buffered
+  }
+
+  // Pick highest priority, then oldest
+  int best = -1;
+  for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+    if (!tx_queue[i].used) {
+      continue;
+    }
+    if (best < 0 ||
+        tx_queue[i].prio < tx_queue[best].prio ||
+        (tx_queue[i].prio == tx_queue[best].prio &&
+         (int32_t)(tx_queue[i].order - tx_queue[best].order) < 0)) {
+      best = i;
+    }
+  }
+  if (best < 0) {
+    return;  // nothing queued
+  }
+
+  TxEntry* e = &tx_queue[best];
+
+  // Drop heartbeats that went stale while the bus was congested
+  if (e->prio >= TX_PRIO_HEARTBEAT && millis() - e->enqueued >= TX_STALE_MS) {
+    e->used = false;
+    tx_dropped++;
+    return;
+  }
+
   checkBusRecovery();
-  
+
   // Prepare message
-  tx_message.identifier = can_id;
-  tx_message.data_length_code = data_len;
+  tx_message.identifier = e->id;
+  tx_message.data_length_code = e->len;
   tx_message.flags = TWAI_MSG_FLAG_NONE;
   tx_message.self = 0;
   tx_message.reserved = 0;
-  
-  // Copy data
-  for (int i = 0; i < data_len && i < 8; i++) {
-    tx_message.data[i] = data[i];
+  for (int i = 0; i < e->len && i < 8; i++) {
+    tx_message.data[i] = e->data[i];
   }
-  
-  // Send message
-  esp_err_t result = twai_transmit(&tx_message, pdMS_TO_TICKS(100));
-  
+
+  // Zero-timeout attempt; a busy driver queue just means we retry next loop
+  MOTCTRL_PERF_SCOPE_BEGIN();
+  esp_err_t result = twai_transmit(&tx_message, 0);
+  MOTCTRL_PERF_SCOPE_END(&perf_tx_stat);
+
   if (result == ESP_OK) {
-    Serial.printf("Sent: CAN ID 0x%03X [", can_id);
-    for (int i = 0; i < data_len; i++) {
-      Serial.printf("0x%02X", data[i]);
-      if (i < data_len - 1) Serial.print(" ");
-    }
-    Serial.println("]");
-    
+    e->used = false;
+    traceEvent(TRACE_EV_CAN_TX, e->id, e->data, e->len);
+
     // Reset error counter on successful transmission
     can_error_count = 0;
     if (can_error_mode) {
       can_error_mode = false;
-      Serial.println("CAN communication restored");
+      traceEvent(TRACE_EV_CAN_RESTORED, 0, NULL, 0);
     }
-    return true;
-  } else {
-    Serial.printf("Failed to send CAN message: %s\n", esp_err_to_name(result));
-    
+  } else if (result != ESP_ERR_TIMEOUT) {
+    // Real failure (not just a full driver queue)
+    uint8_t err = (uint8_t)result;
+    traceEvent(TRACE_EV_CAN_TX_FAIL, e->id, &err, 1);
+
     // Increment error counter
     can_error_count++;
     if (can_error_count >= 3 && !can_error_mode) {
       can_error_mode = true;
-      Serial.println("CAN ERROR MODE: 3+ consecutive failures");
+      traceEvent(TRACE_EV_CAN_ERRMODE, 0, NULL, 0);
     }
-    return false;
+  }
+}
+
+// ============================================================
+// Bus-load governor
+// ============================================================
+// Samples twai_get_status_info() periodically and backs off non-critical
+// traffic when the bus is saturated: the heartbeat interval is stretched
+// (doubling up to GOVERNOR_STRETCH_MAX) and LIMITx_FIND advisories are
+// coalesced in the TX queue, so STATUS_MIN_LIMIT / STATUS_MAX_LIMIT frames
+// always find a free queue slot and a free bus slot.
+
+#define GOVERNOR_SAMPLE_MS   250  // status sampling period (scheduler task period)
+#define GOVERNOR_TXQ_HIGH    3    // driver TX queue depth considered saturated
+#define GOVERNOR_TEC_HIGH    96   // TX error counter in error-warning territory
+#define GOVERNOR_STRETCH_MAX 4    // heartbeat interval multiplier cap
+
+void schedUpdateHeartbeat();  // defined with the scheduler below
+
+void governBusLoad() {
+  twai_status_info_t status_info;
+  if (twai_get_status_info(&status_info) != ESP_OK) {
+    return;
+  }
+
+  bool saturated = status_info.msgs_to_tx >= GOVERNOR_TXQ_HIGH ||
+                   status_info.tx_error_counter >= GOVERNOR_TEC_HIGH;
+  uint8_t stretch = hb_stretch;
+  if (saturated) {
+    if (stretch < GOVERNOR_STRETCH_MAX) {
+      stretch *= 2;
+    }
+  } else if (stretch > 1) {
+    stretch /= 2;  // recover gradually to avoid oscillating
+  }
+  if (stretch != hb_stretch) {
+    hb_stretch = stretch;
+    schedUpdateHeartbeat();
+  }
+}
+
+// ============================================================
+// Cooperative scheduler
+// ============================================================
+// loop() used to interleave its jobs with one ad-hoc `last_* = millis()`
+// timestamp per job. They are now one static table walked in priority order
+// every pass: period-0 tasks run each pass, periodic tasks keep a drift-free
+// deadline advanced by whole periods (never reset to "now", so the long-run
+// rate is exact), and every run is timed against a declared budget. Since
+// each pass still runs every due task, worst-case hall-to-CAN latency is
+// bounded by the sum of the budgets of the tasks ahead of pumpTxQueue
+// (~1 ms) rather than by any timer interaction. Per-task run counts, max
+// runtimes and budget overruns are printed by HOSTCMD_DUMP_PERF.
+
+typedef void (*SchedTaskFn)();
+
+typedef struct {
+  const char* name;
+  SchedTaskFn fn;
+  unsigned long period_ms;   // 0 = run every pass
+  unsigned long budget_us;   // declared worst-case runtime
+  unsigned long next_due;    // absolute millis() deadline for periodic tasks
+  uint32_t runs;
+  uint32_t overruns;         // runs that exceeded budget_us
+  uint32_t max_runtime_us;
+  MCPerfStat cycles;         // cycle statistics (MOTCTRL_PERF_ENABLE)
+} SchedTask;
+
+void checkHallSensor();
+void processRxFrames();
+void drainTraceRing();
+void sendHeartbeat();
+void pumpTelemetry();
+
+// Table order is priority: hall/limit evaluation always runs first in a
+// pass, the heartbeat last. Budgets reflect the analogRead fallback path;
+// in DMA mode the hall task is far cheaper.
+SchedTask sched_tasks[] = {
+  { "hall",      checkHallSensor, 0,                  400, 0, 0, 0, 0, {} },
+  { "rx",        processRxFrames, 0,                  300, 0, 0, 0, 0, {} },
+  { "tx_pump",   pumpTxQueue,     0,                  200, 0, 0, 0, 0, {} },
+  { "governor",  governBusLoad,   GOVERNOR_SAMPLE_MS, 100, 0, 0, 0, 0, {} },
+  { "can_up",    bringUpCAN,      TWAI_RETRY_MS,      500, 0, 0, 0, 0, {} },
+  { "trace",     drainTraceRing,  0,                  600, 0, 0, 0, 0, {} },
+  { "telemetry", pumpTelemetry,   TELEMETRY_CHECK_MS, 150, 0, 0, 0, 0, {} },
+  { "heartbeat", sendHeartbeat,   HEARTBEAT_INTERVAL, 100, 0, 0, 0, 0, {} },
+};
+#define SCHED_TASK_COUNT     ((int)(sizeof(sched_tasks) / sizeof(sched_tasks[0])))
+#define SCHED_TASK_HEARTBEAT (SCHED_TASK_COUNT - 1)
+
+/**
+ * Re-derive the heartbeat task period from the host-set interval and the
+ * governor stretch; pulls the deadline in when the period shrinks
+ */
+void schedUpdateHeartbeat() {
+  SchedTask* t = &sched_tasks[SCHED_TASK_HEARTBEAT];
+  t->period_ms = heartbeat_interval * hb_stretch;
+  unsigned long now = millis();
+  if (t->next_due - now > t->period_ms) {  // unsigned: also catches past-due
+    t->next_due = now + t->period_ms;
   }
 }
 
 /**
- * Send heartbeat message (1 byte: DeviceID only)
+ * Seed the periodic deadlines (call once at the end of setup())
+ */
+void schedInit() {
+  unsigned long now = millis();
+  for (int i = 0; i < SCHED_TASK_COUNT; i++) {
+    sched_tasks[i].next_due = now + sched_tasks[i].period_ms;
+  }
+  schedUpdateHeartbeat();
+}
+
+/**
+ * Run one scheduler pass (loop() context)
+ */
+void schedRun() {
+  unsigned long now = millis();
+  for (int i = 0; i < SCHED_TASK_COUNT; i++) {
+    SchedTask* t = &sched_tasks[i];
+    if (t->period_ms != 0 && (long)(now - t->next_due) < 0) {
+      continue;
+    }
+    unsigned long t0 = micros();
+    MOTCTRL_PERF_SCOPE_BEGIN();
+    t->fn();
+    MOTCTRL_PERF_SCOPE_END(&t->cycles);
+    unsigned long runtime = micros() - t0;
+    t->runs++;
+    if (runtime > t->max_runtime_us) {
+      t->max_runtime_us = runtime;
+    }
+    if (runtime > t->budget_us) {
+      t->overruns++;
+    }
+    if (t->period_ms != 0) {
+      t->next_due += t->period_ms;
+      if ((long)(now - t->next_due) >= (long)t->period_ms) {
+        // fell more than one period behind: resync instead of bursting
+        t->next_due = now + t->period_ms;
+      }
+    }
+  }
+}
+
+/**
+ * Per-task scheduler statistics (appended to the HOSTCMD_DUMP_PERF dump)
+ */
+void dumpSchedStats() {
+  for (int i = 0; i < SCHED_TASK_COUNT; i++) {
+    SchedTask* t = &sched_tasks[i];
+    Serial.printf("task %-9s runs=%lu max=%luus budget=%luus overruns=%lu p99=%lu cyc\n",
+                  t->name,
+                  (unsigned long)t->runs,
+                  (unsigned long)t->max_runtime_us,
+                  t->budget_us,
+                  (unsigned long)t->overruns,
+                  (unsigned long)MCPerfPercentile(&t->cycles, 99));
+  }
+}
+
+/**
+ * Send heartbeat messages: the documented DLC-1 [Device_ID] frame, one per
+ * monitored device. Keeping DLC 1 is what lets receivers tell heartbeats
+ * from the DLC-2 [device_id, status] limit frames on the same CAN ID.
  */
 void sendHeartbeat() {
-  uint8_t payload[1] = {current_device_id};
-  sendCANMessage(CAN_ID_SAFETY, payload, 1);
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    uint8_t payload[1] = {devices[d].device_id};
+    // enqueueCANMessage coalesces by ID and priority only, which would fold
+    // the per-device frames into one; refresh this device's queued copy in
+    // place instead so a stale heartbeat is still replaced, not duplicated
+    bool refreshed = false;
+    for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+      if (tx_queue[i].used && tx_queue[i].id == CAN_ID_SAFETY &&
+          tx_queue[i].prio == TX_PRIO_HEARTBEAT && tx_queue[i].len == 1 &&
+          tx_queue[i].data[0] == devices[d].device_id) {
+        tx_queue[i].enqueued = millis();
+        refreshed = true;
+        break;
+      }
+    }
+    if (!refreshed) {
+      enqueueCANMessage(CAN_ID_SAFETY, payload, 1, TX_PRIO_HEARTBEAT, false);
+    }
+  }
   // Note: LED feedback removed - using Hall sensor LEDs instead
 }
 
@@ -225,21 +828,337 @@ void sendHeartbeat() {
  * Send limit switch trigger message (based on Hall sensor)
  */
 void sendLimitSwitchMessage(uint8_t device_id, uint8_t status) {
+  if (!node_armed) {
+    return;  // disarmed via host command, suppress limit reports
+  }
   uint8_t payload[2] = {device_id, status};
-  sendCANMessage(CAN_ID_SAFETY, payload, 2);
+  // Under bus congestion, FIND-class advisories are coalesced: a newer one
+  // overwrites a queued one in place, so hard limit frames are never touched
+  // and always get a fresh queue slot
+  bool advisory = (status == STATUS_LIMIT1_FIND || status == STATUS_LIMIT2_FIND);
+  if (advisory && hb_stretch > 1) {
+    for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+      if (tx_queue[i].used && tx_queue[i].id == CAN_ID_SAFETY &&
+          tx_queue[i].prio == TX_PRIO_LIMIT && tx_queue[i].len == 2 &&
+          (tx_queue[i].data[1] == STATUS_LIMIT1_FIND || tx_queue[i].data[1] == STATUS_LIMIT2_FIND)) {
+        tx_queue[i].data[0] = device_id;
+        tx_queue[i].data[1] = status;
+        return;
+      }
+    }
+  }
+  enqueueCANMessage(CAN_ID_SAFETY, payload, 2, TX_PRIO_LIMIT, false);
+}
+
+void hallArmWatermarks(SafetyDevice* dev, int value);  // defined with the ADC DMA section below
+int readHallSensor(SafetyDevice* dev);
+
+/**
+ * Differential hall telemetry (scheduler task, TELEMETRY_CHECK_MS period).
+ * Per device: a full 12-bit frame first and every TELEMETRY_RESYNC_N deltas
+ * (or when the move overflows an int8), a one-byte delta frame when the
+ * value left the deadband, nothing otherwise. The receiver accumulates
+ * deltas onto the last full value; deltas are exact, so drift can only come
+ * from a lost frame and the periodic resync bounds how long it lasts.
+ */
+void pumpTelemetry() {
+  if (!telemetry_enabled) {
+    return;
+  }
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    SafetyDevice* dev = &devices[d];
+    int value = readHallSensor(dev);
+    int delta = value - dev->tele_last;
+
+    if (!dev->tele_synced || dev->tele_deltas >= telemetry_resync_n ||
+        delta > 127 || delta < -127) {
+      uint8_t payload[4] = {dev->device_id, TELEMETRY_FULL,
+                            (uint8_t)(value & 0xFF), (uint8_t)((value >> 8) & 0x0F)};
+      if (enqueueCANMessage(CAN_ID_TELEMETRY, payload, 4, TX_PRIO_TELEMETRY, false)) {
+        dev->tele_last = value;
+        dev->tele_deltas = 0;
+        dev->tele_synced = true;
+        tele_full_sent++;
+      }
+    } else if (delta >= (int)telemetry_deadband || delta <= -(int)telemetry_deadband) {
+      uint8_t payload[3] = {dev->device_id, TELEMETRY_DELTA, (uint8_t)(int8_t)delta};
+      if (enqueueCANMessage(CAN_ID_TELEMETRY, payload, 3, TX_PRIO_TELEMETRY, false)) {
+        dev->tele_last = value;
+        dev->tele_deltas++;
+        tele_delta_sent++;
+      }
+    } else {
+      tele_suppressed++;
+    }
+  }
+}
+
+/**
+ * Handle one host command frame (CAN_ID_SAFETY_CMD)
+ */
+void handleHostCommand(const twai_message_t* msg) {
+  if (msg->data_length_code < 1) {
+    return;
+  }
+  switch (msg->data[0]) {
+    case HOSTCMD_ARM:
+      node_armed = true;
+      break;
+    case HOSTCMD_DISARM:
+      node_armed = false;
+      break;
+    case HOSTCMD_SET_HEARTBEAT:
+      if (msg->data_length_code >= 2 && msg->data[1] > 0) {
+        heartbeat_interval = (unsigned long)msg->data[1] * 1000;
+        schedUpdateHeartbeat();
+      }
+      break;
+    case HOSTCMD_SET_THRESHOLD:
+      if (msg->data_length_code >= 4) {
+        int value = (int)msg->data[2] | ((int)msg->data[3] << 8);
+        // Optional 5th byte selects one device; absent applies to all
+        int first = 0;
+        int last = SAFETY_DEVICE_COUNT - 1;
+        if (msg->data_length_code >= 5) {
+          if (msg->data[4] >= SAFETY_DEVICE_COUNT) {
+            return;
+          }
+          first = last = msg->data[4];
+        }
+        for (int d = first; d <= last; d++) {
+          SafetyDevice* dev = &devices[d];
+          switch (msg->data[1]) {
+            case THRESHOLD_IDX_RED_ON:      dev->red_on_threshold = value; break;
+            case THRESHOLD_IDX_RED_BLINK:   dev->red_blink_threshold = value; break;
+            case THRESHOLD_IDX_GREEN_BLINK: dev->green_blink_threshold = value; break;
+            case THRESHOLD_IDX_GREEN_ON:    dev->green_on_threshold = value; break;
+            default: return;
+          }
+          hallArmWatermarks(dev, readHallSensor(dev));  // new boundaries take effect now
+        }
+      }
+      break;
+    case HOSTCMD_DUMP_PERF:
+      dumpPerfStats();  // on-demand, formatting cost is acceptable here
+      break;
+    case HOSTCMD_SET_TELEMETRY:
+      if (msg->data_length_code >= 2) {
+        telemetry_enabled = msg->data[1] != 0;
+        if (msg->data_length_code >= 3 && msg->data[2] > 0) {
+          telemetry_deadband = msg->data[2];
+        }
+        if (msg->data_length_code >= 4 && msg->data[3] > 0) {
+          telemetry_resync_n = msg->data[3];
+        }
+        // Re-baseline so the first frame after a config change is absolute
+        for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+          devices[d].tele_synced = false;
+        }
+      }
+      break;
+    default:
+      return;  // unknown command, don't trace
+  }
+  traceEvent(TRACE_EV_HOST_CMD, (uint16_t)msg->identifier, msg->data, msg->data_length_code);
+}
+
+/**
+ * Drain the RX ring and dispatch host commands (loop() context)
+ */
+void processRxFrames() {
+  twai_message_t msg;
+  while (rxRingPop(&msg)) {
+    if (msg.identifier == CAN_ID_SAFETY_CMD) {
+      handleHostCommand(&msg);
+    }
+  }
+}
+
+// ============================================================
+// Continuous Hall sensor acquisition (ADC DMA)
+// ============================================================
+// The ADC digital controller scans all device channels interleaved at
+// HALL_SAMPLE_FREQ_HZ each into DMA buffers; a background task drains them,
+// demultiplexes samples by channel, and maintains a per-device moving
+// average and slope. The main loop reads filtered values from the device
+// structs instead of paying ~100 us per blocking analogRead(). If DMA setup
+// fails, readHallSensor() falls back to the old synchronous analogRead path.
+
+#define HALL_SAMPLE_FREQ_HZ  4000            // per channel
+#define HALL_DMA_READ_LEN    64              // bytes drained per read
+
+bool hall_dma_active = false;
+
+/**
+ * Initialize the per-device structs (IDs, pins, channels, thresholds)
+ */
+void initDevices() {
+  // Full wiring tables for both hall channels; the first
+  // SAFETY_DEVICE_COUNT entries are used. Device IDs are the fixed protocol
+  // constants -- one board monitors both devices, they are not build flags.
+  static const uint8_t ids[2] = { DEVICE_ID_1, DEVICE_ID_2 };
+  static const uint8_t pins[2] = { HALL_SENSOR_PIN, HALL_SENSOR2_PIN };
+  static const uint8_t channels[2] = { ADC1_CHANNEL_0, ADC1_CHANNEL_1 };
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    SafetyDevice* dev = &devices[d];
+    memset(dev, 0, sizeof(*dev));
+    dev->device_id = ids[d];
+    dev->hall_pin = pins[d];
+    dev->adc_channel = channels[d];
+    dev->red_on_threshold = HALL_RED_ON_THRESHOLD;
+    dev->red_blink_threshold = HALL_RED_BLINK_THRESHOLD;
+    dev->green_blink_threshold = HALL_GREEN_BLINK_THRESHOLD;
+    dev->green_on_threshold = HALL_GREEN_ON_THRESHOLD;
+    dev->prev_avg = -1;
+    dev->wm_low = -32768;  // full range until armed, no events yet
+    dev->wm_high = 32767;
+  }
+}
+
+/**
+ * Zone of a hall value against a device's thresholds
+ */
+HallZone hallZone(const SafetyDevice* dev, int value) {
+  if (value < dev->red_on_threshold) return ZONE_RED_ON;
+  if (value < dev->red_blink_threshold) return ZONE_RED_BLINK;
+  if (value <= dev->green_blink_threshold) return ZONE_NORMAL;
+  if (value <= dev->green_on_threshold) return ZONE_GREEN_BLINK;
+  return ZONE_GREEN_ON;
+}
+
+/**
+ * Arm a device's watermarks for the zone containing value (call after
+ * threshold changes too, so host-adjusted boundaries take effect
+ * immediately). The sampler task compares each filtered value against the
+ * two armed watermarks only; checkHallSensor() runs its threshold ladder on
+ * crossings instead of every loop pass.
+ */
+void hallArmWatermarks(SafetyDevice* dev, int value) {
+  switch (hallZone(dev, value)) {
+    case ZONE_RED_ON:
+      dev->wm_low = -32768;
+      dev->wm_high = dev->red_on_threshold - 1;
+      break;
+    case ZONE_RED_BLINK:
+      dev->wm_low = dev->red_on_threshold;
+      dev->wm_high = dev->red_blink_threshold - 1;
+      break;
+    case ZONE_NORMAL:
+      dev->wm_low = dev->red_blink_threshold;
+      dev->wm_high = dev->green_blink_threshold;
+      break;
+    case ZONE_GREEN_BLINK:
+      dev->wm_low = dev->green_blink_threshold + 1;
+      dev->wm_high = dev->green_on_threshold;
+      break;
+    case ZONE_GREEN_ON:
+      dev->wm_low = dev->green_on_threshold + 1;
+      dev->wm_high = 32767;
+      break;
+  }
+}
+
+/**
+ * Configure the ADC digital controller to scan all device channels
+ */
+bool setupHallDMA() {
+  adc_digi_init_config_t init_config = {};
+  uint32_t chan_mask = 0;
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    chan_mask |= BIT(devices[d].adc_channel);
+  }
+  init_config.max_store_buf_size = 1024;
+  init_config.conv_num_each_intr = HALL_DMA_READ_LEN;
+  init_config.adc1_chan_mask = chan_mask;
+  init_config.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init_config) != ESP_OK) {
+    return false;
+  }
+
+  adc_digi_pattern_config_t patterns[SAFETY_DEVICE_COUNT] = {};
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    patterns[d].atten = ADC_ATTEN_DB_11;
+    patterns[d].channel = devices[d].adc_channel;
+    patterns[d].unit = 0;  // ADC1
+    patterns[d].bit_width = 12;
+  }
+
+  adc_digi_configuration_t dig_cfg = {};
+  dig_cfg.conv_limit_en = 0;
+  dig_cfg.conv_limit_num = 250;
+  dig_cfg.pattern_num = SAFETY_DEVICE_COUNT;
+  dig_cfg.adc_pattern = patterns;
+  // The controller cycles through the pattern table, so the total rate keeps
+  // every channel at HALL_SAMPLE_FREQ_HZ
+  dig_cfg.sample_freq_hz = HALL_SAMPLE_FREQ_HZ * SAFETY_DEVICE_COUNT;
+  dig_cfg.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  dig_cfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&dig_cfg) != ESP_OK) {
+    return false;
+  }
+  return adc_digi_start() == ESP_OK;
+}
+
+/**
+ * Sampler task: drain DMA buffers, demux by channel, update each device's
+ * moving average, slope and watermark events
+ */
+void hallSamplerTask(void* arg) {
+  uint8_t buf[HALL_DMA_READ_LEN];
+  uint32_t read_len = 0;
+
+  for (;;) {
+    if (adc_digi_read_bytes(buf, sizeof(buf), &read_len, ADC_MAX_DELAY) != ESP_OK) {
+      continue;
+    }
+    for (uint32_t i = 0; i + sizeof(adc_digi_output_data_t) <= read_len; i += sizeof(adc_digi_output_data_t)) {
+      adc_digi_output_data_t* sample = (adc_digi_output_data_t*)&buf[i];
+      for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+        SafetyDevice* dev = &devices[d];
+        if (sample->type2.channel != dev->adc_channel) {
+          continue;
+        }
+        dev->window_sum -= dev->window[dev->window_pos];
+        dev->window[dev->window_pos] = sample->type2.data;
+        dev->window_sum += sample->type2.data;
+        dev->window_pos = (dev->window_pos + 1) & (HALL_FILTER_WINDOW - 1);
+        break;
+      }
+    }
+    for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+      SafetyDevice* dev = &devices[d];
+      int avg = (int)(dev->window_sum / HALL_FILTER_WINDOW);
+      if (dev->prev_avg >= 0) {
+        dev->slope = avg - dev->prev_avg;
+      }
+      dev->prev_avg = avg;
+      dev->filtered_value = avg;
+
+      // Watermark compare: two comparisons while the value stays in zone,
+      // re-arm and raise the event only on a boundary crossing
+      if (avg < dev->wm_low || avg > dev->wm_high) {
+        hallArmWatermarks(dev, avg);
+        dev->zone_event = true;
+      }
+    }
+  }
 }
 
 /**
- * Read Hall sensor ADC value
+ * Read a device's Hall sensor value (filtered when DMA sampling is active)
  */
-int readHallSensor() {
-  return analogRead(HALL_SENSOR_PIN);
+int readHallSensor(SafetyDevice* dev) {
+  if (hall_dma_active) {
+    return dev->filtered_value;
+  }
+  return analogRead(dev->hall_pin);
 }
 
 /**
- * Update LED states based on Hall sensor value or CAN error (non-blocking)
+ * Update LED states based on the worst zone across devices or CAN error
+ * (non-blocking)
  */
-void updateLEDs(int hall_value) {
+void updateLEDs(HallZone zone) {
   unsigned long current_time = millis();
   
   // CAN ERROR MODE: Alternate red/green blinking at 2 Hz (250ms per LED)
@@ -259,17 +1178,17 @@ void updateLEDs(int hall_value) {
     return;  // Skip normal LED logic in error mode
   }
   
-  // NORMAL MODE: Hall sensor based LED control
+  // NORMAL MODE: zone based LED control
   bool led_update_due = (current_time - last_led_update >= LED_BLINK_INTERVAL / 2);
-  
-  // Determine LED states based on thresholds
-  if (hall_value < HALL_RED_ON_THRESHOLD) {
+
+  // Determine LED states based on the zone
+  if (zone == ZONE_RED_ON) {
     // Red LED on constantly
     red_blink_mode = false;
     red_led_state = true;
     green_led_state = false;
     green_blink_mode = false;
-  } else if (hall_value < HALL_RED_BLINK_THRESHOLD) {
+  } else if (zone == ZONE_RED_BLINK) {
     // Red LED blink
     red_blink_mode = true;
     green_led_state = false;
@@ -278,13 +1197,13 @@ void updateLEDs(int hall_value) {
       red_led_state = !red_led_state;  // Toggle for blink
       last_led_update = current_time;
     }
-  } else if (hall_value > HALL_GREEN_ON_THRESHOLD) {
+  } else if (zone == ZONE_GREEN_ON) {
     // Green LED on constantly
     green_blink_mode = false;
     green_led_state = true;
     red_led_state = false;
     red_blink_mode = false;
-  } else if (hall_value > HALL_GREEN_BLINK_THRESHOLD) {
+  } else if (zone == ZONE_GREEN_BLINK) {
     // Green LED blink
     green_blink_mode = true;
     red_led_state = false;
@@ -307,190 +1226,226 @@ void updateLEDs(int hall_value) {
 }
 
 /**
- * Debug output for Hall sensor and threshold events
+ * Trace Hall sensor value and threshold events
+ * (binary record into the trace ring; formatting happens at drain time)
  */
-void debugPrintHallSensor(int hall_value, const char* event = nullptr) {
-#if ENABLE_DEBUG_OUTPUT
-  static unsigned long last_print = 0;
-  static int last_printed_value = -1;
+void debugPrintHallSensor(int device_index, int hall_value, uint8_t status = 0) {
+  static unsigned long last_trace[SAFETY_DEVICE_COUNT] = {};
   unsigned long current_time = millis();
-  
-  // Print ADC value every 500ms OR when event occurs
-  bool should_print = (current_time - last_print >= 500) || (event != nullptr);
-  
-  if (should_print) {
-    Serial.printf("[ADC: %4d] ", hall_value);
-    
-    // Print zone information
-    if (hall_value < HALL_RED_ON_THRESHOLD) {
-      Serial.print("RED_ON (Min Limit) ");
-    } else if (hall_value < HALL_RED_BLINK_THRESHOLD) {
-      Serial.print("RED_BLINK (Approaching Min) ");
-    } else if (hall_value > HALL_GREEN_ON_THRESHOLD) {
-      Serial.print("GREEN_ON (Max Limit) ");
-    } else if (hall_value > HALL_GREEN_BLINK_THRESHOLD) {
-      Serial.print("GREEN_BLINK (Approaching Max) ");
-    } else {
-      Serial.print("NORMAL ");
-    }
-    
-    // Print event if any
-    if (event != nullptr) {
-      Serial.printf(">>> EVENT: %s", event);
-    }
-    
-    Serial.println();
-    last_print = current_time;
-    last_printed_value = hall_value;
+
+  // Record every threshold event, and the plain ADC value at most every 500ms
+  if (status == 0 && current_time - last_trace[device_index] < 500) {
+    return;
   }
-#endif
+  last_trace[device_index] = current_time;
+
+  uint8_t payload[3] = {
+    status,
+    (uint8_t)(hall_value & 0xFF),
+    (uint8_t)((hall_value >> 8) & 0xFF)
+  };
+  traceEvent(TRACE_EV_HALL, (uint16_t)device_index, payload, 3);
 }
 
 /**
- * Check Hall sensor and send CAN messages if thresholds crossed
+ * Evaluate one device's threshold ladder and send CAN messages on crossings
  */
-void checkHallSensor() {
-  int hall_value = readHallSensor();
-  unsigned long current_time = millis();
-  
-  // Debounce: only check if enough time has passed
-  if (current_time - last_hall_read < DEBOUNCE_TIME) {  // 50ms debounce
-    return;
-  }
-  last_hall_read = current_time;
-  
+void checkDeviceLimits(int device_index, int hall_value) {
+  SafetyDevice* dev = &devices[device_index];
+
   // Check if value crossed thresholds and send CAN messages
-  // ADC value ranges (according to thresholds):
+  // ADC value ranges (according to default thresholds):
   //   < 2160: Red zone (STATUS_MIN_LIMIT 0x10) - border limit1
   //   2160 <= ADC < 2460: Red blink zone (STATUS_LIMIT1_FIND 0x11) - approaching min limit
   //   2460 <= ADC <= 2860: Normal zone
   //   2860 < ADC <= 3360: Green blink zone (STATUS_LIMIT2_FIND 0x12) - approaching max limit
   //   > 3360: Green zone (STATUS_MAX_LIMIT 0x20) - border limit2
-  
-  // Min limit (red zone: ADC < 2160) - border limit1, send STATUS_MIN_LIMIT 0x10
-  if (hall_value < HALL_RED_ON_THRESHOLD) {
-    if (last_hall_value >= HALL_RED_ON_THRESHOLD) {
+
+  // Min limit (red zone) - border limit1, send STATUS_MIN_LIMIT 0x10
+  if (hall_value < dev->red_on_threshold) {
+    if (dev->last_hall_value >= dev->red_on_threshold) {
       // Just entered red zone (min limit fully triggered)
-      sendLimitSwitchMessage(current_device_id, STATUS_MIN_LIMIT);
-      debugPrintHallSensor(hall_value, "MIN_LIMIT triggered (0x10)");
-      limit1_find_sent = false;  // Reset when min limit is reached
+      sendLimitSwitchMessage(dev->device_id, STATUS_MIN_LIMIT);
+      debugPrintHallSensor(device_index, hall_value, STATUS_MIN_LIMIT);
+      dev->limit1_find_sent = false;  // Reset when min limit is reached
     }
   }
-  
-  // Limit1 Find (red blink zone: 2160 <= ADC < 2460) - send STATUS_LIMIT1_FIND 0x11
-  if (hall_value >= HALL_RED_ON_THRESHOLD && hall_value < HALL_RED_BLINK_THRESHOLD) {
-    if (last_hall_value < HALL_RED_ON_THRESHOLD || last_hall_value >= HALL_RED_BLINK_THRESHOLD) {
+
+  // Limit1 Find (red blink zone) - send STATUS_LIMIT1_FIND 0x11
+  if (hall_value >= dev->red_on_threshold && hall_value < dev->red_blink_threshold) {
+    if (dev->last_hall_value < dev->red_on_threshold || dev->last_hall_value >= dev->red_blink_threshold) {
       // Just entered red blink zone (approaching min limit)
-      if (!limit1_find_sent) {
-        sendLimitSwitchMessage(current_device_id, STATUS_LIMIT1_FIND);
-        debugPrintHallSensor(hall_value, "LIMIT1_FIND - approaching min (0x11)");
-        limit1_find_sent = true;
+      if (!dev->limit1_find_sent) {
+        sendLimitSwitchMessage(dev->device_id, STATUS_LIMIT1_FIND);
+        debugPrintHallSensor(device_index, hall_value, STATUS_LIMIT1_FIND);
+        dev->limit1_find_sent = true;
       }
     }
   } else {
     // Reset flag when leaving red blink zone
-    if (hall_value < HALL_RED_ON_THRESHOLD || hall_value >= HALL_RED_BLINK_THRESHOLD) {
-      limit1_find_sent = false;
+    if (hall_value < dev->red_on_threshold || hall_value >= dev->red_blink_threshold) {
+      dev->limit1_find_sent = false;
     }
   }
-  
-  // Limit2 Find (green blink zone: 2860 < ADC <= 3360) - send STATUS_LIMIT2_FIND 0x12
-  if (hall_value > HALL_GREEN_BLINK_THRESHOLD && hall_value <= HALL_GREEN_ON_THRESHOLD) {
-    if (last_hall_value <= HALL_GREEN_BLINK_THRESHOLD || last_hall_value > HALL_GREEN_ON_THRESHOLD) {
+
+  // Limit2 Find (green blink zone) - send STATUS_LIMIT2_FIND 0x12
+  if (hall_value > dev->green_blink_threshold && hall_value <= dev->green_on_threshold) {
+    if (dev->last_hall_value <= dev->green_blink_threshold || dev->last_hall_value > dev->green_on_threshold) {
       // Just entered green blink zone (approaching max limit)
-      if (!limit2_find_sent) {
-        sendLimitSwitchMessage(current_device_id, STATUS_LIMIT2_FIND);
-        debugPrintHallSensor(hall_value, "LIMIT2_FIND - approaching max (0x12)");
-        limit2_find_sent = true;
+      if (!dev->limit2_find_sent) {
+        sendLimitSwitchMessage(dev->device_id, STATUS_LIMIT2_FIND);
+        debugPrintHallSensor(device_index, hall_value, STATUS_LIMIT2_FIND);
+        dev->limit2_find_sent = true;
       }
     }
   } else {
     // Reset flag when leaving green blink zone
-    if (hall_value <= HALL_GREEN_BLINK_THRESHOLD || hall_value > HALL_GREEN_ON_THRESHOLD) {
-      limit2_find_sent = false;
+    if (hall_value <= dev->green_blink_threshold || hall_value > dev->green_on_threshold) {
+      dev->limit2_find_sent = false;
     }
   }
-  
-  // Max limit (green zone: ADC > 3360) - border limit2, send STATUS_MAX_LIMIT 0x20
-  if (hall_value > HALL_GREEN_ON_THRESHOLD) {
-    if (last_hall_value <= HALL_GREEN_ON_THRESHOLD) {
+
+  // Max limit (green zone) - border limit2, send STATUS_MAX_LIMIT 0x20
+  if (hall_value > dev->green_on_threshold) {
+    if (dev->last_hall_value <= dev->green_on_threshold) {
       // Just entered green zone (max limit fully triggered)
-      sendLimitSwitchMessage(current_device_id, STATUS_MAX_LIMIT);
-      debugPrintHallSensor(hall_value, "MAX_LIMIT triggered (0x20)");
-      limit2_find_sent = false;  // Reset when max limit is reached
+      sendLimitSwitchMessage(dev->device_id, STATUS_MAX_LIMIT);
+      debugPrintHallSensor(device_index, hall_value, STATUS_MAX_LIMIT);
+      dev->limit2_find_sent = false;  // Reset when max limit is reached
     }
   }
-  
-  last_hall_value = hall_value;
-  
-  // Update LEDs
-  updateLEDs(hall_value);
-  
-  // Regular ADC readout
-  debugPrintHallSensor(hall_value);
+
+  dev->last_hall_value = hall_value;
+}
+
+/**
+ * Check all Hall sensors and send CAN messages if thresholds crossed
+ */
+void checkHallSensor() {
+  unsigned long current_time = millis();
+  bool debounce_ok = current_time - last_hall_read >= DEBOUNCE_TIME;
+
+  // LEDs show the most critical zone across devices: red-on beats green-on
+  // beats the blink advisories beats normal
+  static const uint8_t zone_severity[] = { 4, 2, 0, 1, 3 };  // indexed by HallZone
+  HallZone worst_zone = ZONE_NORMAL;
+
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    SafetyDevice* dev = &devices[d];
+    int hall_value = readHallSensor(dev);
+
+    HallZone zone = hallZone(dev, hall_value);
+    if (zone_severity[zone] > zone_severity[worst_zone]) {
+      worst_zone = zone;
+    }
+
+    if (hall_dma_active) {
+      // Event-driven mode: while the value sits inside the armed watermarks
+      // nothing can have crossed a threshold, so skip the ladder entirely
+      if (!dev->zone_event) {
+        debugPrintHallSensor(d, hall_value);
+        continue;
+      }
+      dev->zone_event = false;  // consume the crossing, evaluate immediately
+    } else {
+      // Polling fallback keeps its debounce gate
+      if (!debounce_ok) {
+        continue;
+      }
+    }
+    last_hall_read = current_time;
+
+    checkDeviceLimits(d, hall_value);
+
+    // Regular ADC readout
+    debugPrintHallSensor(d, hall_value);
+  }
+
+  updateLEDs(worst_zone);
 }
 
 
 /**
- * Setup function
+ * Setup function. Ordered as a warm-start fast path: after a brown-out the
+ * gimbal may still be moving, so the hall sensors are read and the limit
+ * ladder evaluated before anything that can wait -- no fixed delays, no
+ * banner printing, no synchronous CAN bring-up ahead of the first
+ * evaluation. Limit events found before the bus is up buffer in the TX
+ * queue and flush once bringUpCAN succeeds.
  */
 void setup() {
-  Serial.begin(115200);
-  delay(1000);
-  
-  Serial.println("ESP32-S2 Safety Node Starting...");
-  Serial.printf("Device ID: 0x%02X\n", current_device_id);
-  Serial.printf("CAN Bitrate: %s\n", CAN_BITRATE_STR);
-  
-  // Configure pins
-  pinMode(HALL_SENSOR_PIN, INPUT);  // ADC input
+  unsigned long boot_start = millis();
+
+  // --- Fast path: first valid limit evaluation ---
+  initDevices();
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    pinMode(devices[d].hall_pin, INPUT);  // ADC input
+  }
   pinMode(LED_GREEN_PIN, OUTPUT);
   pinMode(LED_RED_PIN, OUTPUT);
   digitalWrite(LED_GREEN_PIN, LOW);
   digitalWrite(LED_RED_PIN, LOW);
-  
-  // Initialize ADC
   analogReadResolution(12);  // 12-bit ADC (0-4095)
-  
-  // Initialize TWAI (CAN) bus
-  setupTWAI();
-  
-  // Enable hardware watchdog timer (2 second timeout)
+
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    SafetyDevice* dev = &devices[d];
+    int hall_value = readHallSensor(dev);
+    // Neutral seed: a node that browns out inside a limit zone reports the
+    // limit on this first evaluation instead of treating it as known state
+    dev->last_hall_value = (dev->red_blink_threshold + dev->green_blink_threshold) / 2;
+    hallArmWatermarks(dev, hall_value);
+    checkDeviceLimits(d, hall_value);
+  }
+  unsigned long first_eval_ms = millis() - boot_start;
+
+  // Watchdog armed before the slow path so a hang there still resets
   esp_task_wdt_init(WDT_TIMEOUT_MS / 1000, true);
   esp_task_wdt_add(NULL);
-  
-  // Read initial Hall sensor value
-  last_hall_value = readHallSensor();
-  Serial.printf("Initial Hall sensor value: %d\n", last_hall_value);
-  
-  // Send initial heartbeat
+
+  // --- Slow path: everything the limits don't depend on ---
+  Serial.begin(115200);  // no settle delay; the banner is printed last
+
+  // Start continuous DMA scanning of all hall channels; the synchronous
+  // analogRead path stays as a fallback if the digital controller fails
+  hall_dma_active = setupHallDMA();
+  if (hall_dma_active) {
+    xTaskCreate(hallSamplerTask, "hall_adc", 2048, NULL, configMAX_PRIORITIES - 3, NULL);
+  }
+
+  // First CAN bring-up attempt; on failure the can_up scheduler task keeps
+  // retrying in the background while limit events stay buffered
+  bringUpCAN();
+
+  // Queue the initial heartbeat and seed the scheduler deadlines
   sendHeartbeat();
-  last_heartbeat = millis();
   last_hall_read = millis();
   last_led_update = millis();
-  
-  Serial.println("Safety Node ready");
+  schedInit();
+
+  // --- Deferred diagnostics: the node is already armed and monitoring ---
+  Serial.println("ESP32-S2 Safety Node ready");
+  Serial.printf("First limit evaluation %lu ms after boot\n", first_eval_ms);
+  for (int d = 0; d < SAFETY_DEVICE_COUNT; d++) {
+    Serial.printf("Device %d ID: 0x%02X (hall GPIO %d), initial value %d\n",
+                  d, devices[d].device_id, devices[d].hall_pin, devices[d].last_hall_value);
+  }
+  Serial.printf("CAN Bitrate: %s (%s)\n", CAN_BITRATE_STR,
+                twai_started ? "up" : "retrying in background");
+  if (hall_dma_active) {
+    Serial.printf("Hall ADC DMA sampling %d channels at %d Hz, window %d\n",
+                  SAFETY_DEVICE_COUNT, HALL_SAMPLE_FREQ_HZ, HALL_FILTER_WINDOW);
+  } else {
+    Serial.println("Hall ADC DMA setup failed, using analogRead fallback");
+  }
 }
 
 /**
- * Main loop (non-blocking)
+ * Main loop (non-blocking): feed the watchdog, run one scheduler pass.
+ * See the scheduler section for the task table and priorities.
  */
 void loop() {
-  // Feed watchdog
   esp_task_wdt_reset();
-  
-  unsigned long current_time = millis();
-  
-  // Task 1: Heartbeat Generator (every 5 seconds)
-  if (current_time - last_heartbeat >= HEARTBEAT_INTERVAL) {
-    sendHeartbeat();
-    last_heartbeat = current_time;
-  }
-  
-  // Task 2: Hall Sensor Monitor (with LED control)
-  checkHallSensor();
-  
-  // Non-blocking: yield to other tasks
+  schedRun();
   // No delay() calls - fully non-blocking loop
 }
 